@@ -0,0 +1,369 @@
+#include "ChannelBroker.h"
+
+#include <poll.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <system_error>
+#include <utility>
+
+namespace {
+constexpr size_t HUGE_PAGE = size_t{2} << 20;
+
+// A peer gets this long to send its request and take its reply before the
+// broker drops it; one stuck client must not stall every other request.
+constexpr timeval PEER_TIMEOUT{0, 250'000};
+// How long a client waits for the broker to answer
+constexpr timeval BROKER_TIMEOUT{2, 0};
+
+enum : uint32_t { ACQUIRE = 1, RELEASE = 2 };
+
+struct ChannelRequest {
+  uint32_t op;
+  char name[64];
+  uint64_t bytes;
+};
+
+constexpr uint32_t CREATED = 1;
+constexpr uint32_t HUGE_PAGES = 2;
+
+struct ChannelReply {
+  int32_t error; // errno from the broker; 0 when an fd is attached
+  uint32_t flags;
+  uint64_t bytes;
+};
+
+[[noreturn]] void fail(const std::string &what) {
+  throw std::system_error(errno, std::generic_category(), what);
+}
+
+socklen_t makeAddress(const std::string &path, sockaddr_un &addr) {
+  addr = {};
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr.sun_path)) {
+    errno = ENAMETOOLONG;
+    fail("socket path " + path);
+  }
+  std::memcpy(addr.sun_path, path.data(), path.size());
+  if (path[0] == '@') {
+    addr.sun_path[0] = '\0'; // abstract namespace
+  }
+  return socklen_t(offsetof(sockaddr_un, sun_path) + path.size());
+}
+
+void sendReply(int conn, const ChannelReply &reply, int fd) {
+  iovec iov{const_cast<ChannelReply *>(&reply), sizeof(reply)};
+  msghdr msg{};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+  if (fd != -1) {
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    auto cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    std::memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+  }
+  ::sendmsg(conn, &msg, MSG_NOSIGNAL);
+}
+} // namespace
+
+ChannelBroker::ChannelBroker(const std::string &socketPath, bool hugePages)
+    : mPath(socketPath), mHugePages(hugePages) {
+  sockaddr_un addr;
+  auto len = makeAddress(mPath, addr);
+  mListenFd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (mListenFd == -1) {
+    fail("socket");
+  }
+  if (mPath[0] != '@') {
+    ::unlink(mPath.c_str()); // stale socket from a previous broker
+  }
+  if (::bind(mListenFd, reinterpret_cast<sockaddr *>(&addr), len) == -1 ||
+      ::listen(mListenFd, 64) == -1) {
+    int err = errno;
+    ::close(mListenFd);
+    errno = err;
+    fail("bind " + mPath);
+  }
+}
+
+ChannelBroker::~ChannelBroker() {
+  ::close(mListenFd);
+  if (mPath[0] != '@') {
+    ::unlink(mPath.c_str());
+  }
+  for (auto &[name, channel] : mChannels) {
+    ::close(channel.fd);
+  }
+}
+
+bool ChannelBroker::serveOne(std::chrono::milliseconds timeout) {
+  pollfd pfd{mListenFd, POLLIN, 0};
+  if (::poll(&pfd, 1, int(timeout.count())) <= 0) {
+    return false;
+  }
+  int conn = ::accept4(mListenFd, nullptr, nullptr, SOCK_CLOEXEC);
+  if (conn == -1) {
+    return false;
+  }
+  ::setsockopt(conn, SOL_SOCKET, SO_RCVTIMEO, &PEER_TIMEOUT,
+               sizeof(PEER_TIMEOUT));
+  ::setsockopt(conn, SOL_SOCKET, SO_SNDTIMEO, &PEER_TIMEOUT,
+               sizeof(PEER_TIMEOUT));
+
+  ChannelRequest request{};
+  ChannelReply reply{};
+  int fd = -1;
+  ucred peer{};
+  socklen_t peerLen = sizeof(peer);
+  if (::recv(conn, &request, sizeof(request), MSG_WAITALL) !=
+          ssize_t(sizeof(request)) ||
+      ::getsockopt(conn, SOL_SOCKET, SO_PEERCRED, &peer, &peerLen) == -1) {
+    reply.error = EPROTO;
+  } else if (request.op == RELEASE) {
+    request.name[sizeof(request.name) - 1] = '\0';
+    std::lock_guard lock(mMutex);
+    auto it = mChannels.find(request.name);
+    if (it == mChannels.end() || !dropHolder(it, peer.pid)) {
+      reply.error = ENOENT;
+    }
+  } else if (request.op != ACQUIRE) {
+    reply.error = EPROTO;
+  } else {
+    request.name[sizeof(request.name) - 1] = '\0';
+    std::lock_guard lock(mMutex);
+    auto it = mChannels.find(request.name);
+    if (it == mChannels.end()) {
+      uint64_t bytes = mHugePages
+                           ? (request.bytes + HUGE_PAGE - 1) & ~(HUGE_PAGE - 1)
+                           : request.bytes;
+      fd = ::memfd_create(request.name,
+                          MFD_CLOEXEC | (mHugePages ? MFD_HUGETLB : 0));
+      if (fd == -1 || ::ftruncate(fd, off_t(bytes)) == -1) {
+        reply.error = errno;
+        if (fd != -1) {
+          ::close(fd);
+          fd = -1;
+        }
+      } else {
+        it = mChannels.emplace(request.name, Entry{fd, {}}).first;
+        reply.flags |= CREATED;
+      }
+    } else {
+      fd = it->second.fd;
+    }
+    if (fd != -1) {
+      reply.bytes = uint64_t(::lseek(fd, 0, SEEK_END));
+      if (reply.bytes < request.bytes) {
+        // Same name, different ring type or capacity
+        reply.error = EINVAL;
+        reply.flags = 0;
+        fd = -1;
+      } else {
+        it->second.holders.push_back(peer.pid);
+      }
+    }
+    reply.flags |= mHugePages ? HUGE_PAGES : 0u;
+  }
+  sendReply(conn, reply, fd);
+  ::close(conn);
+  return true;
+}
+
+void ChannelBroker::run() {
+  auto nextReap = std::chrono::steady_clock::now();
+  while (!mStop.load(std::memory_order_relaxed)) {
+    serveOne();
+    if (std::chrono::steady_clock::now() >= nextReap) {
+      reap();
+      nextReap = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    }
+  }
+}
+
+bool ChannelBroker::dropHolder(Channels::iterator it, pid_t pid) {
+  auto &holders = it->second.holders;
+  auto holder = std::find(holders.begin(), holders.end(), pid);
+  if (holder == holders.end()) {
+    return false;
+  }
+  holders.erase(holder);
+  if (holders.empty()) {
+    ::close(it->second.fd);
+    mChannels.erase(it);
+  }
+  return true;
+}
+
+size_t ChannelBroker::reap() {
+  std::lock_guard lock(mMutex);
+  size_t dropped = 0;
+  for (auto it = mChannels.begin(); it != mChannels.end();) {
+    auto &holders = it->second.holders;
+    std::erase_if(holders, [](pid_t pid) {
+      return ::kill(pid, 0) == -1 && errno == ESRCH;
+    });
+    if (holders.empty()) {
+      ::close(it->second.fd);
+      it = mChannels.erase(it);
+      ++dropped;
+    } else {
+      ++it;
+    }
+  }
+  return dropped;
+}
+
+void ChannelBroker::close(const std::string &channel) {
+  std::lock_guard lock(mMutex);
+  auto it = mChannels.find(channel);
+  if (it != mChannels.end()) {
+    ::close(it->second.fd);
+    mChannels.erase(it);
+  }
+}
+
+size_t ChannelBroker::channels() const {
+  std::lock_guard lock(mMutex);
+  return mChannels.size();
+}
+
+namespace {
+// Sends `request` to the broker and waits for its reply; returns the fd
+// that came with it, or -1. Throws if the broker cannot be reached.
+int exchange(const std::string &socketPath, const ChannelRequest &request,
+             ChannelReply &reply) {
+  sockaddr_un addr;
+  auto len = makeAddress(socketPath, addr);
+  int conn = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (conn == -1) {
+    fail("socket");
+  }
+  ::setsockopt(conn, SOL_SOCKET, SO_RCVTIMEO, &BROKER_TIMEOUT,
+               sizeof(BROKER_TIMEOUT));
+  ::setsockopt(conn, SOL_SOCKET, SO_SNDTIMEO, &BROKER_TIMEOUT,
+               sizeof(BROKER_TIMEOUT));
+  if (::connect(conn, reinterpret_cast<sockaddr *>(&addr), len) == -1 ||
+      ::send(conn, &request, sizeof(request), MSG_NOSIGNAL) !=
+          ssize_t(sizeof(request))) {
+    int err = errno;
+    ::close(conn);
+    errno = err;
+    fail("connect to broker " + socketPath);
+  }
+
+  iovec iov{&reply, sizeof(reply)};
+  msghdr msg{};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  auto received = ::recvmsg(conn, &msg, MSG_WAITALL | MSG_CMSG_CLOEXEC);
+  int err = errno;
+  ::close(conn);
+
+  int fd = -1;
+  for (auto cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+      std::memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+    }
+  }
+  if (received != ssize_t(sizeof(reply))) {
+    if (fd != -1) {
+      ::close(fd);
+    }
+    errno = received == -1 ? err : EPROTO;
+    fail("reply from broker " + socketPath);
+  }
+  return fd;
+}
+
+ChannelRequest makeRequest(uint32_t op, const std::string &channel,
+                           uint64_t bytes) {
+  ChannelRequest request{};
+  if (channel.empty() || channel.size() >= sizeof(request.name)) {
+    errno = ENAMETOOLONG;
+    fail("channel name '" + channel + "'");
+  }
+  request.op = op;
+  std::memcpy(request.name, channel.data(), channel.size());
+  request.bytes = bytes;
+  return request;
+}
+} // namespace
+
+ShmSegment requestChannel(const std::string &socketPath,
+                          const std::string &channel, size_t bytes,
+                          const SegmentOptions &options, bool *created) {
+  ChannelReply reply{};
+  int fd = exchange(socketPath, makeRequest(ACQUIRE, channel, bytes), reply);
+  if (reply.error != 0 || fd == -1) {
+    if (fd != -1) {
+      ::close(fd);
+    }
+    errno = reply.error ? reply.error : EPROTO;
+    fail("channel " + channel + " from broker " + socketPath);
+  }
+
+  SegmentOptions mapped = options;
+  mapped.backing = reply.flags & HUGE_PAGES
+                       ? SegmentOptions::Backing::MemfdHugeTlb
+                       : SegmentOptions::Backing::Memfd;
+  if (created) {
+    *created = reply.flags & CREATED;
+  }
+  return ShmSegment::adopt(fd, bytes, reply.flags & CREATED, mapped);
+}
+
+void releaseChannel(const std::string &socketPath,
+                    const std::string &channel) {
+  ChannelReply reply{};
+  int fd = exchange(socketPath, makeRequest(RELEASE, channel, 0), reply);
+  if (fd != -1) {
+    ::close(fd);
+  }
+  if (reply.error != 0) {
+    errno = reply.error;
+    fail("release channel " + channel + " at broker " + socketPath);
+  }
+}
+
+ChannelLease::ChannelLease(ChannelLease &&other) noexcept
+    : mSocketPath(std::move(other.mSocketPath)),
+      mChannel(std::move(other.mChannel)),
+      mHeld(std::exchange(other.mHeld, false)) {}
+
+ChannelLease &ChannelLease::operator=(ChannelLease &&other) noexcept {
+  std::swap(mSocketPath, other.mSocketPath);
+  std::swap(mChannel, other.mChannel);
+  std::swap(mHeld, other.mHeld);
+  return *this;
+}
+
+ChannelLease::~ChannelLease() {
+  try {
+    release();
+  } catch (const std::exception &) {
+    // Broker gone; it reaps this process's hold once we exit
+  }
+}
+
+void ChannelLease::release() {
+  if (mHeld) {
+    mHeld = false;
+    releaseChannel(mSocketPath, mChannel);
+  }
+}
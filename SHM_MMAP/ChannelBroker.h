@@ -0,0 +1,139 @@
+#pragma once
+#include "ShmSegment.h"
+
+#include <sys/types.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Hands out anonymous shared-memory channels over a Unix domain socket.
+//
+// A process asks for a channel by name and size; the broker creates a
+// memfd the first time the name is asked for and sends the same fd to
+// every later asker through SCM_RIGHTS. Nothing appears under /dev/shm, so
+// there are no names to collide on.
+//
+// The broker counts every process that acquired a channel as a holder
+// (by SO_PEERCRED pid) until it sends a release or dies; run() reaps dead
+// holders once a second. When the last holder goes, the broker closes its
+// fd and forgets the name, and the memory is freed as soon as no process
+// still maps it. A reused pid can keep a channel alive until that process
+// exits too.
+//
+// A socket path starting with '@' is bound in the abstract namespace and
+// leaves no file behind either.
+class ChannelBroker {
+public:
+  explicit ChannelBroker(const std::string &socketPath,
+                         bool hugePages = false);
+  ~ChannelBroker();
+
+  ChannelBroker(const ChannelBroker &) = delete;
+  ChannelBroker &operator=(const ChannelBroker &) = delete;
+
+  // Accepts and answers one request; returns false if none arrived within
+  // `timeout`.
+  bool serveOne(std::chrono::milliseconds timeout = std::chrono::milliseconds(100));
+
+  // Serves requests until stop() is called from another thread
+  void run();
+  void stop() { mStop.store(true, std::memory_order_relaxed); }
+
+  // Drops holders that no longer exist and the channels left without any.
+  // Returns the number of channels dropped.
+  size_t reap();
+
+  // Drops the broker's fd for `channel` regardless of holders; later
+  // requests get a fresh one
+  void close(const std::string &channel);
+
+  size_t channels() const;
+
+private:
+  struct Entry {
+    int fd;
+    std::vector<pid_t> holders; // one entry per acquire not yet released
+  };
+  using Channels = std::unordered_map<std::string, Entry>;
+
+  // Removes one hold of `pid`; closes the channel if it was the last.
+  // Returns false if `pid` held none.
+  bool dropHolder(Channels::iterator it, pid_t pid);
+
+  std::string mPath;
+  bool mHugePages;
+  int mListenFd = -1;
+  std::atomic<bool> mStop{false};
+  mutable std::mutex mMutex;
+  Channels mChannels;
+};
+
+// Asks the broker at `socketPath` for `channel` of at least `bytes` and
+// maps it. `created` reports whether this caller got fresh memory.
+// Throws std::system_error if the broker cannot be reached or refuses.
+ShmSegment requestChannel(const std::string &socketPath,
+                          const std::string &channel, size_t bytes,
+                          const SegmentOptions &options = {},
+                          bool *created = nullptr);
+
+// Gives back one hold on `channel` taken by requestChannel()
+void releaseChannel(const std::string &socketPath, const std::string &channel);
+
+// Releases a channel hold when it goes out of scope. Keep it for as long
+// as the channel is in use: once every holder has let go, the next request
+// for the name gets fresh memory.
+class ChannelLease {
+public:
+  ChannelLease(std::string socketPath, std::string channel)
+      : mSocketPath(std::move(socketPath)), mChannel(std::move(channel)) {}
+  ChannelLease(ChannelLease &&other) noexcept;
+  ChannelLease &operator=(ChannelLease &&other) noexcept;
+  ~ChannelLease();
+
+  void release();
+
+private:
+  std::string mSocketPath;
+  std::string mChannel;
+  bool mHeld = true;
+};
+
+// A channel mapped as a typed ring such as ShmRing or ShmBroadcastRing
+template <typename Ring> struct Channel {
+  ShmSegment segment;
+  Ring *ring;
+  ChannelLease lease;
+};
+
+// requestChannel() sized for Ring. The caller that gets fresh memory
+// constructs the ring; everyone else waits up to `timeout` for it to be
+// published and then attaches, which validates the layout.
+template <typename Ring>
+Channel<Ring> openChannel(const std::string &socketPath,
+                          const std::string &channel,
+                          const SegmentOptions &options = {},
+                          std::chrono::milliseconds timeout =
+                              std::chrono::milliseconds(1000)) {
+  bool created = false;
+  auto segment =
+      requestChannel(socketPath, channel, sizeof(Ring), options, &created);
+  ChannelLease lease(socketPath, channel);
+  if (created) {
+    auto ring = Ring::create(segment.data());
+    return {std::move(segment), ring, std::move(lease)};
+  }
+  auto deadline = std::chrono::steady_clock::now() + timeout;
+  auto &magic = static_cast<Ring *>(segment.data())->header.magic;
+  while (magic.load(std::memory_order_acquire) == 0 &&
+         std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::yield();
+  }
+  auto ring = Ring::attach(segment.data());
+  return {std::move(segment), ring, std::move(lease)};
+}
@@ -0,0 +1,307 @@
+#pragma once
+#include "ShmSegment.h"
+
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+
+// A persistent, append-only message log kept as a directory of mmapped
+// files, so a consumer that crashes or restarts loses nothing.
+//
+//   <dir>/index                    layout, commit point, consumer acks
+//   <dir>/00000000000000000000.seg records 0 .. recordsPerSegment-1
+//   <dir>/00000000000001048576.seg the next segment, and so on
+//
+// One JournalWriter appends; any number of JournalReaders, in the same or
+// other processes, read at their own pace. Every record gets the next
+// sequence number. Readers identify themselves by a consumer id whose
+// acknowledged position lives in the index, so a restarted reader resumes
+// where it left off, or seeks back to replay any retained record.
+//
+// Everything sits in the page cache through MAP_SHARED, which survives
+// process crashes; sync() additionally makes it survive a machine crash.
+
+struct JournalIndex {
+  static constexpr uint64_t MAGIC = 0x4c414e52'554f4a21; // "!JOURNAL"
+  static constexpr uint32_t VERSION = 1;
+  static constexpr uint32_t MAX_CONSUMERS = 16;
+  static constexpr size_t CACHE_LINE = 64;
+
+  struct alignas(CACHE_LINE) Ack {
+    std::atomic<uint64_t> next{0}; // first sequence not yet acknowledged
+  };
+
+  std::atomic<uint64_t> magic{0}; // written last when the index is created
+  uint32_t version = VERSION;
+  uint32_t elementSize = 0;
+  uint64_t recordsPerSegment = 0;
+
+  alignas(CACHE_LINE) std::atomic<uint64_t> committed{0}; // next sequence
+  std::atomic<uint64_t> firstRetained{0}; // older segments were trimmed
+
+  Ack acks[MAX_CONSUMERS];
+};
+
+template <typename T> struct JournalRecord {
+  uint64_t seq; // lets a reader check it is where it thinks it is
+  T value;
+};
+
+namespace journal_detail {
+inline std::string segmentPath(const std::string &dir, uint64_t firstSeq) {
+  char name[32];
+  std::snprintf(name, sizeof(name), "/%020llu.seg",
+                static_cast<unsigned long long>(firstSeq));
+  return dir + name;
+}
+
+// Journal files keep their contents across opens: no warm-up writes, and
+// no mlock since segments are long-lived and potentially many.
+inline SegmentOptions fileOptions() {
+  SegmentOptions options;
+  options.backing = SegmentOptions::Backing::File;
+  options.warmUp = false;
+  options.lock = false;
+  return options;
+}
+
+// Segments are mapped on the hot path whenever append() or read() rolls
+// over; MAP_POPULATE would fault in the whole file right there, so pages
+// are faulted one at a time as records reach them instead.
+inline SegmentOptions segmentOptions() {
+  SegmentOptions options = fileOptions();
+  options.populate = false;
+  return options;
+}
+} // namespace journal_detail
+
+template <typename T> class JournalWriter {
+  static_assert(std::is_trivially_copyable_v<T>,
+                "records are written to disk byte for byte");
+
+public:
+  // Opens the journal in `dir`, creating it if needed. An existing journal
+  // keeps its segment size and continues after its last committed record;
+  // a half-written record from a crashed writer is overwritten.
+  explicit JournalWriter(const std::string &dir,
+                         uint64_t recordsPerSegment = 1 << 20)
+      : mDir(dir), mIndexFile(openIndex(dir)),
+        mIndex(static_cast<JournalIndex *>(mIndexFile.data())) {
+    if (mIndex->magic.load(std::memory_order_acquire) != JournalIndex::MAGIC) {
+      new (mIndex) JournalIndex;
+      mIndex->elementSize = sizeof(T);
+      mIndex->recordsPerSegment = recordsPerSegment;
+      mIndex->magic.store(JournalIndex::MAGIC, std::memory_order_release);
+    } else if (mIndex->version != JournalIndex::VERSION ||
+               mIndex->elementSize != sizeof(T)) {
+      throw std::runtime_error("journal " + dir + ": element size " +
+                               std::to_string(mIndex->elementSize) +
+                               ", expected " + std::to_string(sizeof(T)));
+    }
+    mPerSegment = mIndex->recordsPerSegment;
+    mNext = mIndex->committed.load(std::memory_order_relaxed);
+    mapSegment(mNext);
+  }
+
+  // Appends one record and returns its sequence number
+  uint64_t append(const T &value) {
+    if (mNext - mSegmentFirst == mPerSegment) {
+      mapSegment(mNext); // roll over to a new file
+    }
+    auto &record = mRecords[mNext - mSegmentFirst];
+    record.value = value;
+    record.seq = mNext;
+    mIndex->committed.store(mNext + 1, std::memory_order_release);
+    return mNext++;
+  }
+
+  uint64_t nextSeq() const { return mNext; }
+
+  // Flushes the current segment and the index to disk (msync, MS_SYNC).
+  // Earlier segments were flushed when the writer rolled past them.
+  void sync() {
+    ::msync(mSegment->data(), mSegment->size(), MS_SYNC);
+    ::msync(mIndexFile.data(), mIndexFile.size(), MS_SYNC);
+  }
+
+  // Deletes segment files holding only records below `seq`. The caller
+  // picks the bound, typically the lowest acked() of the consumers it
+  // cares about; trimmed records can no longer be replayed.
+  void trimBefore(uint64_t seq) {
+    uint64_t first = mIndex->firstRetained.load(std::memory_order_relaxed);
+    uint64_t limit = seq - seq % mPerSegment;
+    if (limit > mSegmentFirst) {
+      limit = mSegmentFirst;
+    }
+    if (limit <= first) {
+      return;
+    }
+    // Published before deleting so readers never look for a missing file
+    mIndex->firstRetained.store(limit, std::memory_order_release);
+    for (uint64_t s = first - first % mPerSegment; s < limit;
+         s += mPerSegment) {
+      std::filesystem::remove(journal_detail::segmentPath(mDir, s));
+    }
+  }
+
+private:
+  static ShmSegment openIndex(const std::string &dir) {
+    std::filesystem::create_directories(dir);
+    return ShmSegment::create(dir + "/index", sizeof(JournalIndex),
+                              journal_detail::fileOptions());
+  }
+
+  void mapSegment(uint64_t seq) {
+    if (mSegment) {
+      ::msync(mSegment->data(), mSegment->size(), MS_ASYNC);
+    }
+    mSegmentFirst = seq - seq % mPerSegment;
+    mSegment.emplace(ShmSegment::create(
+        journal_detail::segmentPath(mDir, mSegmentFirst),
+        mPerSegment * sizeof(JournalRecord<T>),
+        journal_detail::segmentOptions()));
+    mRecords = static_cast<JournalRecord<T> *>(mSegment->data());
+  }
+
+  std::string mDir;
+  ShmSegment mIndexFile;
+  JournalIndex *mIndex;
+  uint64_t mPerSegment = 0;
+  std::optional<ShmSegment> mSegment;
+  JournalRecord<T> *mRecords = nullptr;
+  uint64_t mSegmentFirst = 0;
+  uint64_t mNext = 0;
+};
+
+template <typename T> class JournalReader {
+  static_assert(std::is_trivially_copyable_v<T>,
+                "records are read from disk byte for byte");
+
+public:
+  // Attaches to the journal in `dir` as `consumer` and resumes after the
+  // last record that consumer acknowledged, or at the oldest retained
+  // record if those were trimmed.
+  JournalReader(const std::string &dir, uint32_t consumer)
+      : mDir(dir), mConsumer(consumer),
+        mIndexFile(ShmSegment::open(dir + "/index", sizeof(JournalIndex),
+                                    journal_detail::fileOptions())),
+        mIndex(static_cast<JournalIndex *>(mIndexFile.data())) {
+    if (mIndex->magic.load(std::memory_order_acquire) != JournalIndex::MAGIC ||
+        mIndex->version != JournalIndex::VERSION ||
+        mIndex->elementSize != sizeof(T)) {
+      throw std::runtime_error("journal " + dir + ": bad or foreign index");
+    }
+    if (consumer >= JournalIndex::MAX_CONSUMERS) {
+      throw std::out_of_range("journal consumer id " +
+                              std::to_string(consumer));
+    }
+    mPerSegment = mIndex->recordsPerSegment;
+    seek(std::max(acked(),
+                  mIndex->firstRetained.load(std::memory_order_acquire)));
+  }
+
+  // Reads the next committed record. Returns false if the reader is at the
+  // end of the journal; retry later to follow the writer live. Throws
+  // std::out_of_range if the writer trimmed the record away; seek() past it.
+  bool read(T &out) {
+    if (mPos == mCommittedCached) {
+      mCommittedCached = mIndex->committed.load(std::memory_order_acquire);
+      if (mPos == mCommittedCached) {
+        return false;
+      }
+    }
+    if (!mSegment || mPos - mSegmentFirst == mPerSegment) {
+      mapSegment(mPos);
+    }
+    const auto &record = mRecords[mPos - mSegmentFirst];
+    if (record.seq != mPos) {
+      throw std::runtime_error("journal " + mDir + ": record " +
+                               std::to_string(mPos) + " is corrupt");
+    }
+    out = record.value;
+    ++mPos;
+    return true;
+  }
+
+  // Sequence number of the record read() returns next
+  uint64_t position() const { return mPos; }
+
+  // Moves to `seq` for replay or to skip ahead; throws std::out_of_range if
+  // it was trimmed or has not been written yet.
+  void seek(uint64_t seq) {
+    uint64_t first = mIndex->firstRetained.load(std::memory_order_acquire);
+    mCommittedCached = mIndex->committed.load(std::memory_order_acquire);
+    if (seq < first || seq > mCommittedCached) {
+      throw std::out_of_range("journal seek to " + std::to_string(seq) +
+                              ", retained [" + std::to_string(first) + ", " +
+                              std::to_string(mCommittedCached) + "]");
+    }
+    mPos = seq;
+    mSegment.reset(); // remapped by the next read()
+  }
+
+  // Records everything read so far as processed; a restarted reader with
+  // the same consumer id starts after it.
+  void ack() { ack(mPos); }
+
+  // Acknowledges every record below `next`
+  void ack(uint64_t next) {
+    mIndex->acks[mConsumer].next.store(next, std::memory_order_release);
+  }
+
+  uint64_t acked() const {
+    return mIndex->acks[mConsumer].next.load(std::memory_order_acquire);
+  }
+
+  // Committed records not yet read
+  uint64_t backlog() const {
+    return mIndex->committed.load(std::memory_order_acquire) - mPos;
+  }
+
+private:
+  // The file may be deleted by a concurrent trimBefore() between the check
+  // and the open; the open then fails and the check is repeated.
+  void mapSegment(uint64_t seq) {
+    checkRetained(seq);
+    mSegmentFirst = seq - seq % mPerSegment;
+    try {
+      mSegment.emplace(ShmSegment::open(
+          journal_detail::segmentPath(mDir, mSegmentFirst),
+          mPerSegment * sizeof(JournalRecord<T>),
+          journal_detail::segmentOptions()));
+    } catch (const std::system_error &) {
+      checkRetained(seq);
+      throw;
+    }
+    mRecords = static_cast<const JournalRecord<T> *>(mSegment->data());
+  }
+
+  void checkRetained(uint64_t seq) const {
+    uint64_t first = mIndex->firstRetained.load(std::memory_order_acquire);
+    if (seq < first) {
+      throw std::out_of_range("journal read of " + std::to_string(seq) +
+                              ", trimmed below " + std::to_string(first));
+    }
+  }
+
+  std::string mDir;
+  uint32_t mConsumer;
+  ShmSegment mIndexFile;
+  JournalIndex *mIndex;
+  uint64_t mPerSegment = 0;
+  std::optional<ShmSegment> mSegment;
+  const JournalRecord<T> *mRecords = nullptr;
+  uint64_t mSegmentFirst = 0;
+  uint64_t mPos = 0;
+  uint64_t mCommittedCached = 0;
+};
@@ -0,0 +1,207 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+// Result of ShmBroadcastRing::pop()
+enum class ReadStatus {
+  Ok,     // a message was copied out
+  Empty,  // the reader is caught up
+  Lapped, // the reader fell too far behind; call resync()
+};
+
+// One writer, up to MaxReaders reader processes, all sharing one mapping.
+// Every reader registers a slot in the header and advances its own cursor,
+// so one feed is written once no matter how many processes consume it.
+//
+// The writer never waits for anyone. A reader more than maxLag messages
+// behind is marked lapped when the writer next scans, and a reader that
+// finds its next message already overwritten marks itself lapped; either
+// way pop() reports Lapped until the reader calls resync() and jumps to
+// the newest message. Each slot carries a seqlock so a torn copy is
+// detected rather than returned.
+template <typename T, uint32_t Capacity, uint32_t MaxReaders = 16>
+struct ShmBroadcastRing {
+  static_assert(std::is_trivially_copyable_v<T>,
+                "messages are copied between processes byte for byte");
+  static_assert(Capacity != 0 && (Capacity & (Capacity - 1)) == 0,
+                "Capacity must be a power of two");
+
+  using value_type = T;
+
+  static constexpr uint64_t MAGIC = 0x54534143'44414f52; // "ROADCAST"
+  static constexpr uint32_t VERSION = 1;
+  static constexpr size_t CACHE_LINE = 64;
+
+  struct Header {
+    std::atomic<uint64_t> magic{0}; // written last by the writer
+    uint32_t version = VERSION;
+    uint32_t elementSize = sizeof(T);
+    uint32_t capacity = Capacity;
+    uint32_t maxReaders = MaxReaders;
+    uint32_t maxLag = Capacity;
+  };
+
+  enum ReaderState : uint32_t { FREE, ACTIVE, LAPPED };
+
+  struct alignas(CACHE_LINE) ReaderSlot {
+    std::atomic<uint32_t> state{FREE};
+    std::atomic<uint64_t> cursor{0}; // next message this reader wants
+  };
+
+  struct Slot {
+    // 2n+1 while message n is being written, 2n+2 once it is complete
+    std::atomic<uint64_t> seq{0};
+    T value;
+  };
+
+  // Construct a fresh ring in `memory`, which must hold sizeof(ShmBroadcastRing)
+  // bytes. Readers lagging by maxLag messages or more are evicted; maxLag
+  // is clamped to (0, Capacity].
+  static ShmBroadcastRing *create(void *memory, uint32_t maxLag = Capacity) {
+    auto ring = new (memory) ShmBroadcastRing;
+    ring->header.maxLag = maxLag == 0 || maxLag > Capacity ? Capacity : maxLag;
+    ring->header.magic.store(MAGIC, std::memory_order_release);
+    return ring;
+  }
+
+  // Check the header the writer wrote and use the ring in `memory`.
+  // Throws std::runtime_error on a missing or mismatched header.
+  static ShmBroadcastRing *attach(void *memory) {
+    auto ring = static_cast<ShmBroadcastRing *>(memory);
+    auto &h = ring->header;
+    if (h.magic.load(std::memory_order_acquire) != MAGIC) {
+      throw std::runtime_error("shm broadcast: not initialised by a writer");
+    }
+    if (h.version != VERSION || h.elementSize != sizeof(T) ||
+        h.capacity != Capacity || h.maxReaders != MaxReaders) {
+      throw std::runtime_error(
+          "shm broadcast: layout mismatch (version " +
+          std::to_string(h.version) + ", element size " +
+          std::to_string(h.elementSize) + ", capacity " +
+          std::to_string(h.capacity) + ", readers " +
+          std::to_string(h.maxReaders) + ")");
+    }
+    return ring;
+  }
+
+  // Writer: publish one message. Never fails and never waits.
+  void push(const T &val) {
+    uint64_t n = writeSeq.load(std::memory_order_relaxed);
+    if (n - minCursorCached >= header.maxLag) {
+      evictLagging(n);
+    }
+
+    Slot &slot = slots[n & (Capacity - 1)];
+    slot.seq.store(2 * n + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(&slot.value, &val, sizeof(T));
+    slot.seq.store(2 * n + 2, std::memory_order_release);
+    writeSeq.store(n + 1, std::memory_order_release);
+  }
+
+  // Reader: claim a slot starting at the newest message.
+  // Returns the reader id, or -1 if all MaxReaders slots are taken.
+  int registerReader() {
+    for (uint32_t i = 0; i < MaxReaders; ++i) {
+      uint32_t expected = FREE;
+      // Claimed as LAPPED so the writer ignores it until resync() has set
+      // a valid cursor.
+      if (readers[i].state.compare_exchange_strong(
+              expected, LAPPED, std::memory_order_acq_rel)) {
+        resync(int(i));
+        return int(i);
+      }
+    }
+    return -1;
+  }
+
+  void unregisterReader(int reader) {
+    readers[reader].state.store(FREE, std::memory_order_release);
+  }
+
+  ReadStatus pop(int reader, T &out) {
+    ReaderSlot &r = readers[reader];
+    if (r.state.load(std::memory_order_relaxed) != ACTIVE) {
+      return ReadStatus::Lapped;
+    }
+    uint64_t c = r.cursor.load(std::memory_order_relaxed);
+    const Slot &slot = slots[c & (Capacity - 1)];
+
+    uint64_t seq = slot.seq.load(std::memory_order_acquire);
+    if (seq < 2 * c + 2) { // not written yet, or being written
+      return ReadStatus::Empty;
+    }
+    if (seq == 2 * c + 2) {
+      std::memcpy(&out, &slot.value, sizeof(T));
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot.seq.load(std::memory_order_relaxed) == seq) {
+        r.cursor.store(c + 1, std::memory_order_release);
+        return ReadStatus::Ok;
+      }
+    }
+    // Message c was overwritten before or while we copied it
+    r.state.store(LAPPED, std::memory_order_relaxed);
+    return ReadStatus::Lapped;
+  }
+
+  // Reader: skip to the newest message and become active again.
+  // Returns the number of messages skipped.
+  uint64_t resync(int reader) {
+    ReaderSlot &r = readers[reader];
+    uint64_t from = r.cursor.load(std::memory_order_relaxed);
+    uint64_t to = writeSeq.load(std::memory_order_acquire);
+    // The cursor must be visible before the writer can see ACTIVE
+    r.cursor.store(to, std::memory_order_relaxed);
+    r.state.store(ACTIVE, std::memory_order_release);
+    return to - from;
+  }
+
+  bool lapped(int reader) const {
+    return readers[reader].state.load(std::memory_order_relaxed) == LAPPED;
+  }
+
+  // Messages published but not yet read by `reader`
+  uint64_t backlog(int reader) const {
+    return writeSeq.load(std::memory_order_acquire) -
+           readers[reader].cursor.load(std::memory_order_acquire);
+  }
+
+  static constexpr uint32_t capacity() { return Capacity; }
+
+  alignas(CACHE_LINE) Header header;
+
+  alignas(CACHE_LINE) std::atomic<uint64_t> writeSeq{0}; // writer writes
+  uint64_t minCursorCached = 0; // writer only: slowest active cursor seen
+
+  ReaderSlot readers[MaxReaders];
+
+  alignas(CACHE_LINE) Slot slots[Capacity];
+
+private:
+  // Marks every active reader at least maxLag behind `n` as lapped and
+  // remembers the slowest one left, so the scan runs once per maxLag
+  // messages at most rather than on every push.
+  void evictLagging(uint64_t n) {
+    uint64_t slowest = n;
+    for (auto &r : readers) {
+      if (r.state.load(std::memory_order_acquire) != ACTIVE) {
+        continue;
+      }
+      uint64_t c = r.cursor.load(std::memory_order_acquire);
+      if (n - c >= header.maxLag) {
+        uint32_t expected = ACTIVE;
+        r.state.compare_exchange_strong(expected, LAPPED,
+                                        std::memory_order_relaxed);
+      } else if (c < slowest) {
+        slowest = c;
+      }
+    }
+    minCursorCached = slowest;
+  }
+};
@@ -0,0 +1,228 @@
+#pragma once
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+// Single-producer single-consumer ring that lives in a shared mapping.
+// The whole object is the mapping: map sizeof(ShmRing<T, Capacity>) bytes,
+// create() it in the producer and attach() to it in the consumer. The
+// header records the layout the producer was built with so a consumer
+// compiled against a different message type or capacity fails loudly
+// instead of reading garbage.
+//
+// push()/pop() never block. A consumer that may go idle can use popWait()
+// instead, which spins for a while and then sleeps on a futex in the
+// shared mapping; its producer must then push with pushNotify() (or call
+// notify() after commit()), which costs one fence plus a load while nobody
+// sleeps. reserve()/commit() and peek()/release() work on the slot in the
+// mapping directly, saving the copy through a local T on each side.
+template <typename T, uint32_t Capacity> struct ShmRing {
+  static_assert(std::is_trivially_copyable_v<T>,
+                "messages are copied between processes byte for byte");
+  static_assert(Capacity != 0 && (Capacity & (Capacity - 1)) == 0,
+                "Capacity must be a power of two");
+
+  using value_type = T;
+
+  static constexpr uint64_t MAGIC = 0x474e4952'4d485321; // "!SHMRING"
+  static constexpr uint32_t VERSION = 2;
+  static constexpr size_t CACHE_LINE = 64;
+
+  struct Header {
+    std::atomic<uint64_t> magic{0}; // written last by the producer
+    uint32_t version = VERSION;
+    uint32_t elementSize = sizeof(T);
+    uint32_t elementAlign = alignof(T);
+    uint32_t capacity = Capacity;
+  };
+
+  // Construct a fresh ring in `memory`, which must hold sizeof(ShmRing)
+  // bytes. Any ring already there is reset.
+  static ShmRing *create(void *memory) {
+    auto ring = new (memory) ShmRing;
+    ring->header.magic.store(MAGIC, std::memory_order_release);
+    return ring;
+  }
+
+  // Check the header the producer wrote and use the ring in `memory`.
+  // Throws std::runtime_error if it was never initialised or was built
+  // with a different layout.
+  static ShmRing *attach(void *memory) {
+    auto ring = static_cast<ShmRing *>(memory);
+    auto &h = ring->header;
+    if (h.magic.load(std::memory_order_acquire) != MAGIC) {
+      throw std::runtime_error("shm ring: not initialised by a producer");
+    }
+    if (h.version != VERSION) {
+      throw std::runtime_error("shm ring: version " +
+                               std::to_string(h.version) + ", expected " +
+                               std::to_string(VERSION));
+    }
+    if (h.elementSize != sizeof(T) || h.elementAlign != alignof(T)) {
+      throw std::runtime_error("shm ring: element size " +
+                               std::to_string(h.elementSize) +
+                               ", expected " + std::to_string(sizeof(T)));
+    }
+    if (h.capacity != Capacity) {
+      throw std::runtime_error("shm ring: capacity " +
+                               std::to_string(h.capacity) + ", expected " +
+                               std::to_string(Capacity));
+    }
+    return ring;
+  }
+
+  // Zero-copy write: returns the next free slot in the mapping, or nullptr
+  // if the ring is FULL. Build the message there, then commit() it.
+  T *reserve() {
+    uint64_t push = pushPtr.load(std::memory_order_relaxed);
+    if (push - popCached == Capacity) {
+      popCached = popPtr.load(std::memory_order_acquire);
+      if (push - popCached == Capacity) { // FULL
+        return nullptr;
+      }
+    }
+    return &arr[push & (Capacity - 1)];
+  }
+
+  // Publish the slot returned by the last reserve()
+  void commit() {
+    pushPtr.store(pushPtr.load(std::memory_order_relaxed) + 1,
+                  std::memory_order_release);
+  }
+
+  // Zero-copy read: returns the oldest message in place, or nullptr if the
+  // ring is EMPTY. It stays valid until release() hands it back.
+  const T *peek() {
+    uint64_t pop = popPtr.load(std::memory_order_relaxed);
+    if (pop == pushCached) {
+      pushCached = pushPtr.load(std::memory_order_acquire);
+      if (pop == pushCached) { // EMPTY
+        return nullptr;
+      }
+    }
+    return &arr[pop & (Capacity - 1)];
+  }
+
+  // Free the slot returned by the last peek()
+  void release() {
+    popPtr.store(popPtr.load(std::memory_order_relaxed) + 1,
+                 std::memory_order_release);
+  }
+
+  bool push(const T &val) {
+    T *slot = reserve();
+    if (!slot) {
+      return false;
+    }
+    *slot = val; // write payload first
+    commit();
+    return true;
+  }
+
+  bool pop(T &out) {
+    const T *slot = peek();
+    if (!slot) {
+      return false;
+    }
+    out = *slot; // read payload first
+    release();
+    return true;
+  }
+
+  // Wake a consumer sleeping in popWait(); call after push() or commit()
+  // on a ring whose consumer may sleep.
+  void notify() {
+    // Pairs with the fence in popWait(): either we see the sleeper or it
+    // sees the message before going to sleep.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleepers.load(std::memory_order_relaxed) != 0) {
+      wakeSeq.fetch_add(1, std::memory_order_release);
+      futex(FUTEX_WAKE, INT_MAX);
+    }
+  }
+
+  // push() that wakes a consumer sleeping in popWait()
+  bool pushNotify(const T &val) {
+    if (!push(val)) {
+      return false;
+    }
+    notify();
+    return true;
+  }
+
+  // pop() that tries `spins` times and then sleeps until pushNotify()
+  // or notify() publishes a message. Always returns with a message in `out`.
+  void popWait(T &out, uint32_t spins = 4096) {
+    for (uint32_t i = 0; i < spins; ++i) {
+      if (pop(out)) {
+        return;
+      }
+#if defined(__x86_64__) || defined(__i386__)
+      __builtin_ia32_pause();
+#endif
+    }
+    while (true) {
+      uint32_t seq = wakeSeq.load(std::memory_order_acquire);
+      sleepers.fetch_add(1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (pop(out)) {
+        sleepers.fetch_sub(1, std::memory_order_relaxed);
+        return;
+      }
+      // Returns at once if a wake happened since `seq` was read
+      futex(FUTEX_WAIT, seq);
+      sleepers.fetch_sub(1, std::memory_order_relaxed);
+      if (pop(out)) {
+        return;
+      }
+    }
+  }
+
+  bool empty() const { return size() == 0; }
+
+  bool full() const { return size() == Capacity; }
+
+  uint32_t size() const {
+    uint64_t pop = popPtr.load(std::memory_order_acquire);
+    uint64_t push = pushPtr.load(std::memory_order_acquire);
+    return static_cast<uint32_t>(push - pop);
+  }
+
+  static constexpr uint32_t capacity() { return Capacity; }
+
+  alignas(CACHE_LINE) Header header;
+
+  // Cursors count messages ever pushed/popped and never wrap in practice;
+  // each sits on its own line with a private copy of the other side's.
+  alignas(CACHE_LINE) std::atomic<uint64_t> pushPtr{0}; // producer writes
+  uint64_t popCached = 0;                               // producer only
+
+  alignas(CACHE_LINE) std::atomic<uint64_t> popPtr{0}; // consumer writes
+  uint64_t pushCached = 0;                             // consumer only
+
+  // Idle-consumer wakeup. FUTEX_WAIT/FUTEX_WAKE without FUTEX_PRIVATE_FLAG
+  // so the kernel keys the word by its physical page and processes with
+  // different mappings still meet.
+  alignas(CACHE_LINE) std::atomic<uint32_t> wakeSeq{0}; // futex word
+  std::atomic<uint32_t> sleepers{0};
+
+  alignas(CACHE_LINE) T arr[Capacity];
+
+private:
+  static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t));
+
+  void futex(int op, uint32_t val) {
+    ::syscall(SYS_futex, reinterpret_cast<uint32_t *>(&wakeSeq), op, val,
+              nullptr, nullptr, 0);
+  }
+
+};
@@ -0,0 +1,208 @@
+#include "ShmSegment.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <system_error>
+#include <utility>
+
+namespace {
+constexpr size_t PAGE = 4096;
+constexpr size_t HUGE_PAGE = size_t{2} << 20;
+
+[[noreturn]] void fail(const std::string &what) {
+  throw std::system_error(errno, std::generic_category(), what);
+}
+
+bool hugePages(SegmentOptions::Backing backing) {
+  return backing == SegmentOptions::Backing::HugeTlbFs ||
+         backing == SegmentOptions::Backing::MemfdHugeTlb;
+}
+
+const char *backingName(SegmentOptions::Backing backing) {
+  switch (backing) {
+  case SegmentOptions::Backing::PosixShm:
+    return "posix-shm";
+  case SegmentOptions::Backing::HugeTlbFs:
+    return "hugetlbfs";
+  case SegmentOptions::Backing::Memfd:
+    return "memfd";
+  case SegmentOptions::Backing::MemfdHugeTlb:
+    return "memfd-hugetlb";
+  case SegmentOptions::Backing::File:
+    return "file";
+  }
+  return "?";
+}
+} // namespace
+
+ShmSegment ShmSegment::create(const std::string &name, size_t bytes,
+                              const SegmentOptions &options) {
+  auto start = std::chrono::steady_clock::now();
+  ShmSegment segment;
+  segment.mOptions = options;
+
+  switch (options.backing) {
+  case SegmentOptions::Backing::PosixShm:
+    segment.mFd = ::shm_open(name.c_str(), O_CREAT | O_RDWR, 0777);
+    break;
+  case SegmentOptions::Backing::HugeTlbFs:
+    segment.mFd =
+        ::open((options.hugetlbfsDir + name).c_str(), O_CREAT | O_RDWR, 0777);
+    break;
+  case SegmentOptions::Backing::Memfd:
+    segment.mFd = ::memfd_create(name.c_str(), 0);
+    break;
+  case SegmentOptions::Backing::MemfdHugeTlb:
+    segment.mFd = ::memfd_create(name.c_str(), MFD_HUGETLB);
+    break;
+  case SegmentOptions::Backing::File:
+    segment.mFd = ::open(name.c_str(), O_CREAT | O_RDWR, 0644);
+    break;
+  }
+  if (segment.mFd == -1) {
+    fail(std::string("create ") + backingName(options.backing) + " " + name);
+  }
+
+  // hugetlb files can only be sized and mapped in whole huge pages
+  size_t length =
+      hugePages(options.backing) ? (bytes + HUGE_PAGE - 1) & ~(HUGE_PAGE - 1)
+                                 : bytes;
+  if (::ftruncate(segment.mFd, off_t(length)) == -1) {
+    fail("ftruncate " + name);
+  }
+  segment.map(length, true);
+  segment.mSetupTime = std::chrono::steady_clock::now() - start;
+  return segment;
+}
+
+ShmSegment ShmSegment::open(const std::string &name, size_t minBytes,
+                            const SegmentOptions &options) {
+  auto start = std::chrono::steady_clock::now();
+  ShmSegment segment;
+  segment.mOptions = options;
+
+  switch (options.backing) {
+  case SegmentOptions::Backing::PosixShm:
+    segment.mFd = ::shm_open(name.c_str(), O_RDWR, 0777);
+    break;
+  case SegmentOptions::Backing::HugeTlbFs:
+    segment.mFd = ::open((options.hugetlbfsDir + name).c_str(), O_RDWR);
+    break;
+  case SegmentOptions::Backing::Memfd:
+  case SegmentOptions::Backing::MemfdHugeTlb:
+    segment.mFd = ::open(name.c_str(), O_RDWR); // /proc/<pid>/fd/<fd>
+    break;
+  case SegmentOptions::Backing::File:
+    segment.mFd = ::open(name.c_str(), O_RDWR);
+    break;
+  }
+  if (segment.mFd == -1) {
+    fail(std::string("open ") + backingName(options.backing) + " " + name);
+  }
+
+  segment.mapWhole(minBytes, false, name);
+  segment.mSetupTime = std::chrono::steady_clock::now() - start;
+  return segment;
+}
+
+ShmSegment ShmSegment::adopt(int fd, size_t minBytes, bool creator,
+                             const SegmentOptions &options) {
+  auto start = std::chrono::steady_clock::now();
+  ShmSegment segment;
+  segment.mOptions = options;
+  segment.mFd = fd;
+  segment.mapWhole(minBytes, creator, "fd " + std::to_string(fd));
+  segment.mSetupTime = std::chrono::steady_clock::now() - start;
+  return segment;
+}
+
+// Maps all of mFd after checking it holds at least `minBytes`
+void ShmSegment::mapWhole(size_t minBytes, bool creator,
+                          const std::string &name) {
+  struct stat st {};
+  if (::fstat(mFd, &st) == -1) {
+    fail("fstat " + name);
+  }
+  if (size_t(st.st_size) < minBytes) {
+    errno = EINVAL;
+    fail(name + " holds " + std::to_string(st.st_size) + " bytes, need " +
+         std::to_string(minBytes));
+  }
+  map(size_t(st.st_size), creator);
+}
+
+// `creator` decides how pages are warmed: the creator writes them, which
+// allocates them; anyone else only reads, so it cannot clobber live data.
+void ShmSegment::map(size_t length, bool creator) {
+  int flags = MAP_SHARED | (mOptions.populate ? MAP_POPULATE : 0);
+  void *addr =
+      ::mmap(nullptr, length, PROT_READ | PROT_WRITE, flags, mFd, 0);
+  if (addr == MAP_FAILED) {
+    fail("mmap " + std::to_string(length) + " bytes");
+  }
+  mAddr = addr;
+  mLength = length;
+  prepare(creator);
+}
+
+void ShmSegment::prepare(bool creator) {
+  if (mOptions.warmUp) {
+    size_t step = hugePages(mOptions.backing) ? HUGE_PAGE : PAGE;
+    auto bytes = static_cast<volatile char *>(mAddr);
+    for (size_t offset = 0; offset < mLength; offset += step) {
+      if (creator) {
+        bytes[offset] = 0;
+      } else {
+        (void)bytes[offset];
+      }
+    }
+  }
+  if (mOptions.lock) {
+    // Commonly fails under a small RLIMIT_MEMLOCK; describe() reports it
+    mLocked = ::mlock(mAddr, mLength) == 0;
+  }
+}
+
+ShmSegment::ShmSegment(ShmSegment &&other) noexcept
+    : mOptions(std::move(other.mOptions)),
+      mAddr(std::exchange(other.mAddr, nullptr)),
+      mLength(std::exchange(other.mLength, 0)),
+      mFd(std::exchange(other.mFd, -1)), mLocked(other.mLocked),
+      mSetupTime(other.mSetupTime) {}
+
+ShmSegment &ShmSegment::operator=(ShmSegment &&other) noexcept {
+  // `other` now owns our old mapping and releases it when it dies
+  std::swap(mOptions, other.mOptions);
+  std::swap(mAddr, other.mAddr);
+  std::swap(mLength, other.mLength);
+  std::swap(mFd, other.mFd);
+  std::swap(mLocked, other.mLocked);
+  std::swap(mSetupTime, other.mSetupTime);
+  return *this;
+}
+
+ShmSegment::~ShmSegment() {
+  if (mAddr) {
+    ::munmap(mAddr, mLength);
+  }
+  if (mFd != -1) {
+    ::close(mFd);
+  }
+}
+
+std::string ShmSegment::describe() const {
+  char buf[160];
+  std::snprintf(buf, sizeof(buf), "%.1f MiB %s%s%s%s, setup %.2f ms",
+                double(mLength) / double(1 << 20),
+                backingName(mOptions.backing),
+                mOptions.populate ? " populate" : "",
+                mOptions.lock ? (mLocked ? " mlock" : " mlock-failed") : "",
+                mOptions.warmUp ? " warm-up" : "",
+                double(mSetupTime.count()) / 1e6);
+  return buf;
+}
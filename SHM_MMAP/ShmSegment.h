@@ -0,0 +1,73 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+// How a shared-memory segment is backed and prepared before first use.
+// The defaults take every page fault and TLB miss at startup rather than
+// on the first pass over the ring.
+struct SegmentOptions {
+  enum class Backing {
+    PosixShm,     // shm_open under /dev/shm, 4K pages
+    HugeTlbFs,    // a file in hugetlbfsDir, 2MB pages
+    Memfd,        // memfd_create: anonymous, 4K pages
+    MemfdHugeTlb, // memfd_create(MFD_HUGETLB): anonymous, 2MB pages
+    File,         // a regular file at the given path; contents persist
+  };
+
+  Backing backing = Backing::PosixShm;
+  std::string hugetlbfsDir = "/dev/hugepages";
+  bool populate = true; // MAP_POPULATE: fault the whole mapping in mmap()
+  bool lock = true;     // mlock so pages are never reclaimed; best effort
+  bool warmUp = true;   // touch every page; writes on create, reads on open
+};
+
+// An mmapped shared-memory segment that unmaps and closes itself.
+//
+// create() makes (or resizes) the segment and maps it; open() maps one
+// another process created. Both time themselves: setupTime() covers
+// open, truncate, map, populate, touch and lock. A memfd segment has no
+// name another process can open; open() then expects a path such as
+// /proc/<pid>/fd/<fd>, or the fd is handed over (see ChannelBroker) and
+// mapped with adopt().
+// create() on an existing segment keeps its contents, except that warmUp
+// zeroes the first byte of every page; turn it off to reopen a File.
+class ShmSegment {
+public:
+  static ShmSegment create(const std::string &name, size_t bytes,
+                           const SegmentOptions &options = {});
+  static ShmSegment open(const std::string &name, size_t minBytes,
+                         const SegmentOptions &options = {});
+  // Maps a segment from an fd received from elsewhere and takes ownership
+  // of the fd. `creator` says whether this process warms the pages by
+  // writing (fresh memory) or only by reading (live data).
+  static ShmSegment adopt(int fd, size_t minBytes, bool creator,
+                          const SegmentOptions &options = {});
+
+  ShmSegment(ShmSegment &&other) noexcept;
+  ShmSegment &operator=(ShmSegment &&other) noexcept;
+  ~ShmSegment();
+
+  void *data() const { return mAddr; }
+  size_t size() const { return mLength; }
+  int fd() const { return mFd; }
+  bool locked() const { return mLocked; }
+  std::chrono::nanoseconds setupTime() const { return mSetupTime; }
+
+  // e.g. "16.0 MiB posix-shm populate mlock warm-up, setup 4.12 ms"
+  std::string describe() const;
+
+private:
+  ShmSegment() = default;
+
+  void mapWhole(size_t minBytes, bool creator, const std::string &name);
+  void map(size_t length, bool creator);
+  void prepare(bool creator);
+
+  SegmentOptions mOptions;
+  void *mAddr = nullptr;
+  size_t mLength = 0;
+  int mFd = -1;
+  bool mLocked = false;
+  std::chrono::nanoseconds mSetupTime{};
+};
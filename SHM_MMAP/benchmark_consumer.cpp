@@ -3,9 +3,7 @@
 
 static void BM_ConsumerRun(benchmark::State& state) {
   const std::string shm_name = "/kartik_shm";
-  size_t totalBytes = 16 * 1024 * 1024;
-
-  Consumer consumer(shm_name, totalBytes);
+  Consumer consumer(shm_name);
 
   for (auto _ : state) {
     consumer.run();     // measure full run()
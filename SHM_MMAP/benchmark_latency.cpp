@@ -0,0 +1,252 @@
+// One-way latency of ShmRing between two processes.
+//
+// The parent maps a ring, forks, and the child becomes the producer: it
+// stamps every message with the TSC right before pushing it. The parent
+// pops and records now - stamp in a histogram. Each message size runs
+// twice: "burst" pushes flat out and gives throughput plus latency under
+// load; "paced" leaves --gap_ns between pushes and gives the latency of a
+// ring that is mostly empty, which is what a quiet feed sees.
+//
+// The TSC must be invariant and synchronised across cores (constant_tsc
+// and nonstop_tsc in /proc/cpuinfo), or cross-core stamps are meaningless.
+//
+//   bench_latency --producer_cpu=2 --consumer_cpu=4 --messages=10000000
+#include "ShmRing.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+static int producerCpu = -1;
+static int consumerCpu = -1;
+static uint64_t messages = 1'000'000;
+static uint64_t gapNs = 1000;
+
+static constexpr uint32_t RING_CAPACITY = 4096;
+// Dropped from the statistics while page faults and caches settle
+static constexpr uint64_t WARMUP = 10'000;
+
+static uint64_t ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+// TSC ticks per nanosecond, measured against steady_clock
+static double ticksPerNs() {
+  using namespace std::chrono;
+  auto start = steady_clock::now();
+  auto startTicks = ticks();
+  std::this_thread::sleep_for(milliseconds(100));
+  auto ns = duration_cast<nanoseconds>(steady_clock::now() - start).count();
+  return double(ticks() - startTicks) / double(ns);
+}
+
+static void pin(int cpu) {
+  if (cpu < 0) {
+    return;
+  }
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  ::sched_setaffinity(0, sizeof(set), &set);
+}
+
+// Busy-waits with a pause instruction, then yields so that both sides
+// still make progress when they are pinned to the same core.
+struct Backoff {
+  unsigned spins = 0;
+
+  void operator()() {
+    if (++spins < 128) {
+#if defined(__x86_64__) || defined(__i386__)
+      __builtin_ia32_pause();
+#endif
+    } else {
+      sched_yield();
+    }
+  }
+};
+
+// Log-linear buckets: exact below 64 ns, then 32 buckets per power of two,
+// so every percentile is within ~3% of the true value at any magnitude.
+class LatencyHistogram {
+public:
+  void record(uint64_t ns) {
+    ++mBuckets[bucket(ns)];
+    mMax = std::max(mMax, ns);
+    ++mCount;
+  }
+
+  // Lower bound of the bucket holding the p-th fraction of samples
+  uint64_t percentile(double p) const {
+    auto rank = uint64_t(p * double(mCount - 1));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < mBuckets.size(); ++i) {
+      seen += mBuckets[i];
+      if (seen > rank) {
+        return lowerBound(i);
+      }
+    }
+    return mMax;
+  }
+
+  uint64_t max() const { return mMax; }
+
+private:
+  static size_t bucket(uint64_t ns) {
+    if (ns < 64) {
+      return ns;
+    }
+    auto shift = std::bit_width(ns) - 6;
+    return 64 + (shift - 1) * 32 + ((ns >> shift) - 32);
+  }
+
+  static uint64_t lowerBound(size_t index) {
+    if (index < 64) {
+      return index;
+    }
+    auto shift = (index - 64) / 32 + 1;
+    return ((index - 64) % 32 + 32) << shift;
+  }
+
+  std::vector<uint64_t> mBuckets = std::vector<uint64_t>(64 + 58 * 32);
+  uint64_t mMax = 0;
+  uint64_t mCount = 0;
+};
+
+template <size_t Size> struct Message {
+  static_assert(Size >= 16);
+  uint64_t tsc;
+  uint64_t seq;
+  char payload[Size - 16];
+};
+
+template <size_t Size> static void runOnce(bool paced, double perNs) {
+  using Ring = ShmRing<Message<Size>, RING_CAPACITY>;
+  void *memory = ::mmap(nullptr, sizeof(Ring), PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (memory == MAP_FAILED) {
+    std::perror("mmap");
+    std::exit(1);
+  }
+  Ring::create(memory);
+
+  pid_t child = ::fork();
+  if (child == 0) {
+    pin(producerCpu);
+    auto ring = Ring::attach(memory);
+    Message<Size> msg{};
+    auto gapTicks = uint64_t(double(gapNs) * perNs);
+    auto next = ticks();
+    for (uint64_t i = 0; i < messages; ++i) {
+      if (paced) {
+        next += gapTicks;
+        while (ticks() < next) {
+        }
+      }
+      msg.seq = i;
+      msg.tsc = ticks();
+      Backoff backoff;
+      while (!ring->push(msg)) {
+        backoff();
+      }
+    }
+    ::_exit(0);
+  }
+
+  pin(consumerCpu);
+  auto ring = Ring::attach(memory);
+  LatencyHistogram histogram;
+  Message<Size> msg;
+  uint64_t first = 0, last = 0;
+  for (uint64_t i = 0; i < messages; ++i) {
+    Backoff backoff;
+    while (!ring->pop(msg)) {
+      backoff();
+    }
+    last = ticks();
+    if (msg.seq != i) {
+      std::fprintf(stderr, "out of order: got %lu, expected %lu\n",
+                   (unsigned long)msg.seq, (unsigned long)i);
+      std::exit(1);
+    }
+    if (i == WARMUP) {
+      first = last;
+    }
+    if (i >= WARMUP) {
+      histogram.record(uint64_t(double(last - msg.tsc) / perNs));
+    }
+  }
+  ::waitpid(child, nullptr, 0);
+  ::munmap(memory, sizeof(Ring));
+
+  auto seconds = double(last - first) / perNs / 1e9;
+  auto rate = double(messages - WARMUP - 1) / seconds;
+  std::printf("%6zu  %-6s  %12.2f  %10.1f  %8lu  %8lu  %8lu  %8lu\n", Size,
+              paced ? "paced" : "burst", rate / 1e6,
+              rate * Size / double(1 << 20),
+              (unsigned long)histogram.percentile(0.50),
+              (unsigned long)histogram.percentile(0.99),
+              (unsigned long)histogram.percentile(0.9999),
+              (unsigned long)histogram.max());
+}
+
+template <size_t Size> static void run(double perNs) {
+  runOnce<Size>(false, perNs);
+  runOnce<Size>(true, perNs);
+}
+
+int main(int argc, char **argv) {
+  for (int i = 1; i < argc; ++i) {
+    if (std::strncmp(argv[i], "--producer_cpu=", 15) == 0) {
+      producerCpu = std::atoi(argv[i] + 15);
+    } else if (std::strncmp(argv[i], "--consumer_cpu=", 15) == 0) {
+      consumerCpu = std::atoi(argv[i] + 15);
+    } else if (std::strncmp(argv[i], "--messages=", 11) == 0) {
+      messages = std::strtoull(argv[i] + 11, nullptr, 10);
+    } else if (std::strncmp(argv[i], "--gap_ns=", 9) == 0) {
+      gapNs = std::strtoull(argv[i] + 9, nullptr, 10);
+    } else {
+      std::fprintf(stderr,
+                   "usage: %s [--producer_cpu=N] [--consumer_cpu=N] "
+                   "[--messages=N] [--gap_ns=N]\n",
+                   argv[0]);
+      return 1;
+    }
+  }
+  if (messages <= WARMUP + 1) {
+    std::fprintf(stderr, "--messages must exceed %lu\n",
+                 (unsigned long)(WARMUP + 1));
+    return 1;
+  }
+
+  auto perNs = ticksPerNs();
+  std::printf("tsc %.3f GHz, %lu messages, gap %lu ns, producer cpu %d, "
+              "consumer cpu %d\n",
+              perNs, (unsigned long)messages, (unsigned long)gapNs,
+              producerCpu, consumerCpu);
+  std::printf("%6s  %-6s  %12s  %10s  %8s  %8s  %8s  %8s\n", "bytes", "mode",
+              "Mmsg/s", "MiB/s", "p50_ns", "p99_ns", "p99.99_ns", "max_ns");
+  run<16>(perNs);
+  run<64>(perNs);
+  run<256>(perNs);
+  run<1024>(perNs);
+}
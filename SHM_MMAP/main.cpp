@@ -9,15 +9,26 @@ int main(int argc, char **argv) {
 
   auto app_type = argv[1];
   auto shm_name = argv[2];
+  // Optional ChannelBroker socket: the ring then comes from the broker as
+  // an anonymous memfd and shm_name is only the channel's name.
+  auto broker_socket = argc > 3 ? argv[3] : nullptr;
   cout << app_type << endl;
-  size_t totalBytesOfMemory = 16*1024*1024; // 16 mb
-  if (std::string(app_type) == "producer") {
-    Producer producer{std::string(shm_name), totalBytesOfMemory};
+  if (std::string(app_type) == "broker") {
+    ChannelBroker broker{std::string(shm_name)}; // shm_name is the socket
+    broker.run();
+  } else if (std::string(app_type) == "producer") {
+    Producer producer =
+        broker_socket
+            ? Producer{shm_name, openChannel<SHM>(broker_socket, shm_name)}
+            : Producer{std::string(shm_name)};
     std::cout <<"SLEEPING 2\n";
     ::sleep(2);
     producer.run();
   } else {
-    Consumer consumer{std::string(shm_name), totalBytesOfMemory};
+    Consumer consumer =
+        broker_socket
+            ? Consumer{shm_name, openChannel<SHM>(broker_socket, shm_name)}
+            : Consumer{std::string(shm_name)};
     consumer.run();
   }
 }
@@ -1,34 +1,30 @@
 #include "producer.h"
 
-#include <fcntl.h>
 #include <iostream>
-#include <sys/mman.h>
 #include <unistd.h>
 
-Producer::Producer(const std::string &shm_name, size_t total)
-    : SHM_name(shm_name), totalBytes(total) {
-  // 1. WE NEED  A MEMORY OF 16 MB FROM KERNEL
-  const char *shm_file = "/kartik_shm";
-
-  // ::open("sdfhdsjds")
-  int shm_fd = ::shm_open(shm_file, O_CREAT | O_RDWR, 0777);
-  if (shm_fd ==  -1)
-    std::cout <<"producer didn't get the file\n";
-  ::ftruncate(shm_fd,
-              totalBytes + 4 + 4); // allocating 4,4 bytes for push and pop
+Producer::Producer(const std::string &shm_name, const SegmentOptions &options)
+    : SHM_name(shm_name),
+      // 1. WE NEED sizeof(SHM) BYTES OF SHARED MEMORY FROM KERNEL, faulted
+      // in and locked before the first push
+      mSegment(ShmSegment::create(SHM_name, sizeof(SHM), options)) {
+  std::cout << "producer segment: " << mSegment.describe() << "\n";
+  mSHMPtr = SHM::create(mSegment.data());
+}
 
-  void *raw_ptr = ::mmap(nullptr, totalBytes + 4 + 4, PROT_READ | PROT_WRITE,
-                         MAP_SHARED, shm_fd, 0);
-  mSHMPtr = reinterpret_cast<SHM *>(raw_ptr);
+Producer::Producer(const std::string &channel, Channel<SHM> &&mapped)
+    : SHM_name(channel), mSegment(std::move(mapped.segment)),
+      mLease(std::move(mapped.lease)), mSHMPtr(mapped.ring) {
+  std::cout << "producer channel: " << mSegment.describe() << "\n";
 }
 
 void Producer::run() {
   srand(time(NULL));
   while (true) {
-    size_t store = rand();
-    store = store % 1000;
-    std::cout << store << "\n";
-    // mSHMPtr->push(store)
+    SHM::value_type store = rand() % 1000;
+    while (!mSHMPtr->pushNotify(store)) {
+      // FULL: wait for the consumer
+    }
   }
 }
 
@@ -1,15 +1,21 @@
 #pragma once
+#include "ChannelBroker.h"
 #include "SHM.h"
+#include "ShmSegment.h"
 
+#include <optional>
 #include <string>
 class Producer {
 private:
   std::string SHM_name;
-  size_t totalBytes;
+  ShmSegment mSegment;
+  std::optional<ChannelLease> mLease; // set when mapped from a broker
   SHM* mSHMPtr;
 
 public:
-  Producer(const std::string &, size_t);
+  explicit Producer(const std::string &, const SegmentOptions & = {});
+  // Uses a ring already mapped from a ChannelBroker
+  Producer(const std::string &channel, Channel<SHM> &&mapped);
 
   void run();
-};
\ No newline at end of file
+};
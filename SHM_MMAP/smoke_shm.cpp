@@ -0,0 +1,534 @@
+// Instantiates the shared-memory types in this directory and checks basic
+// behaviour, with the two sides in separate processes where that is how
+// they are used. Built with the benchmarks so that a header that stops
+// compiling breaks the build; run it to catch a ring that loses or
+// reorders messages.
+#include "ChannelBroker.h"
+#include "Journal.h"
+#include "ShmBroadcast.h"
+#include "ShmRing.h"
+#include "ShmSegment.h"
+
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+
+// Unlike assert(), stays active in Release builds
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      std::fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__,   \
+                   #cond);                                                     \
+      std::abort();                                                            \
+    }                                                                          \
+  } while (0)
+
+// Anonymous shared mapping that survives fork(), zero-filled
+static void *mapShared(size_t bytes) {
+  void *memory = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (memory == MAP_FAILED) {
+    std::perror("mmap");
+    std::exit(1);
+  }
+  return memory;
+}
+
+// Runs `fn` in a forked child; a failed CHECK there fails joinChild()
+template <typename Fn> static pid_t inChild(Fn fn) {
+  pid_t child = ::fork();
+  CHECK(child >= 0);
+  if (child == 0) {
+    fn();
+    std::fflush(nullptr);
+    ::_exit(0);
+  }
+  return child;
+}
+
+static void joinChild(pid_t child) {
+  int status = 0;
+  CHECK(::waitpid(child, &status, 0) == child);
+  CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+template <typename Exception, typename Fn> static bool throws(Fn fn) {
+  try {
+    fn();
+  } catch (const Exception &) {
+    return true;
+  }
+  return false;
+}
+
+struct Message {
+  uint64_t seq;
+  uint64_t check;
+};
+
+static void smokeShmRing() {
+  using Ring = ShmRing<Message, 8>;
+  // Large enough for the bigger layout attach() is tried with below
+  size_t bytes = sizeof(ShmRing<Message, 16>);
+  void *memory = mapShared(bytes);
+
+  // attach() refuses a ring nobody created and one built with another layout
+  CHECK(throws<std::runtime_error>([&] { Ring::attach(memory); }));
+  auto ring = Ring::create(memory);
+  CHECK(Ring::attach(memory) == ring);
+  CHECK(throws<std::runtime_error>(
+      [&] { ShmRing<uint32_t, 8>::attach(memory); }));
+  CHECK(throws<std::runtime_error>(
+      [&] { ShmRing<Message, 16>::attach(memory); }));
+
+  Message msg{};
+  CHECK(ring->empty() && !ring->pop(msg));
+  for (uint64_t i = 0; i < Ring::capacity(); ++i) {
+    CHECK(ring->push(Message{i, i * 3}));
+  }
+  CHECK(ring->full() && !ring->push(Message{}));
+  for (uint64_t i = 0; i < Ring::capacity(); ++i) {
+    CHECK(ring->pop(msg) && msg.seq == i);
+  }
+
+  // A child process produces, this one consumes
+  constexpr uint64_t count = 100'000;
+  pid_t child = inChild([&] {
+    auto producer = Ring::attach(memory);
+    for (uint64_t i = 0; i < count; ++i) {
+      while (!producer->push(Message{i, i * 3})) {
+        std::this_thread::yield();
+      }
+    }
+  });
+  for (uint64_t i = 0; i < count;) {
+    if (!ring->pop(msg)) {
+      std::this_thread::yield();
+      continue;
+    }
+    CHECK(msg.seq == i && msg.check == i * 3);
+    ++i;
+  }
+  joinChild(child);
+  CHECK(ring->empty());
+  ::munmap(memory, bytes);
+}
+
+static void smokeShmRingWait() {
+  using Ring = ShmRing<Message, 8>;
+  void *memory = mapShared(sizeof(Ring));
+  auto ring = Ring::create(memory);
+
+  // With no spins every empty popWait() sleeps on the futex; the producer
+  // pauses now and then so the consumer is asleep when a message arrives
+  constexpr uint64_t count = 2'000;
+  pid_t child = inChild([&] {
+    auto producer = Ring::attach(memory);
+    for (uint64_t i = 0; i < count; ++i) {
+      if (i % 100 == 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+      if (i % 2 == 0) {
+        while (!producer->pushNotify(Message{i, i * 3})) {
+          std::this_thread::yield();
+        }
+      } else {
+        Message *slot;
+        while (!(slot = producer->reserve())) {
+          std::this_thread::yield();
+        }
+        *slot = Message{i, i * 3};
+        producer->commit();
+        producer->notify();
+      }
+    }
+  });
+  Message msg;
+  for (uint64_t i = 0; i < count; ++i) {
+    ring->popWait(msg, i % 2 == 0 ? 0 : 64);
+    CHECK(msg.seq == i && msg.check == i * 3);
+  }
+  joinChild(child);
+  CHECK(ring->empty() && ring->sleepers.load() == 0);
+  ::munmap(memory, sizeof(Ring));
+}
+
+static void smokeShmRingInPlace() {
+  using Ring = ShmRing<Message, 4>;
+  void *memory = mapShared(sizeof(Ring));
+  auto ring = Ring::create(memory);
+
+  // Both sides work on the slot in the mapping itself
+  CHECK(ring->peek() == nullptr);
+  for (uint64_t i = 0; i < Ring::capacity(); ++i) {
+    Message *slot = ring->reserve();
+    CHECK(slot == &ring->arr[i]);
+    // Reserving again without a commit hands out the same slot
+    CHECK(ring->reserve() == slot);
+    *slot = Message{i, i * 3};
+    ring->commit();
+  }
+  CHECK(ring->reserve() == nullptr);
+  const Message *front = ring->peek();
+  CHECK(front == &ring->arr[0] && front->seq == 0);
+  CHECK(ring->peek() == front);
+  ring->release();
+  CHECK(ring->reserve() == &ring->arr[0]);
+  CHECK(ring->peek()->seq == 1);
+
+  // A forked producer fills slots in place for this process to read in place
+  constexpr uint64_t count = 100'000;
+  void *stream = mapShared(sizeof(Ring));
+  auto consumer = Ring::create(stream);
+  pid_t child = inChild([&] {
+    auto producer = Ring::attach(stream);
+    for (uint64_t i = 0; i < count; ++i) {
+      Message *slot;
+      while (!(slot = producer->reserve())) {
+        std::this_thread::yield();
+      }
+      slot->seq = i;
+      slot->check = i * 3;
+      producer->commit();
+    }
+  });
+  for (uint64_t i = 0; i < count;) {
+    const Message *msg = consumer->peek();
+    if (!msg) {
+      std::this_thread::yield();
+      continue;
+    }
+    CHECK(msg->seq == i && msg->check == i * 3);
+    consumer->release();
+    ++i;
+  }
+  joinChild(child);
+  ::munmap(stream, sizeof(Ring));
+  ::munmap(memory, sizeof(Ring));
+}
+
+static void smokeShmBroadcastRing() {
+  using Ring = ShmBroadcastRing<Message, 8, 4>;
+  void *memory = mapShared(sizeof(Ring));
+  CHECK(throws<std::runtime_error>([&] { Ring::attach(memory); }));
+
+  // The writer evicts a reader maxLag behind without waiting for it
+  {
+    auto ring = Ring::create(memory, 4);
+    int fast = ring->registerReader();
+    int slow = ring->registerReader();
+    CHECK(fast >= 0 && slow >= 0 && fast != slow);
+    Message msg;
+    CHECK(ring->pop(fast, msg) == ReadStatus::Empty);
+    for (uint64_t i = 0; i < 5; ++i) {
+      ring->push(Message{i, i * 3});
+      CHECK(ring->pop(fast, msg) == ReadStatus::Ok && msg.seq == i);
+    }
+    CHECK(ring->lapped(slow) && !ring->lapped(fast));
+    CHECK(ring->pop(slow, msg) == ReadStatus::Lapped);
+    CHECK(ring->resync(slow) == 5 && ring->backlog(slow) == 0);
+    ring->push(Message{5, 15});
+    CHECK(ring->pop(slow, msg) == ReadStatus::Ok && msg.seq == 5);
+    CHECK(ring->pop(fast, msg) == ReadStatus::Ok && msg.seq == 5);
+
+    // Slots run out at MaxReaders and are reusable once freed
+    CHECK(ring->registerReader() >= 0 && ring->registerReader() >= 0);
+    CHECK(ring->registerReader() == -1);
+    ring->unregisterReader(slow);
+    CHECK(ring->registerReader() == slow);
+  }
+
+  // Reader processes see an increasing, untorn subsequence of the feed and
+  // recover from every lap. Readers register before the writer starts, so
+  // both start at message 0.
+  {
+    auto ring = Ring::create(memory);
+    auto done =
+        new (mapShared(sizeof(std::atomic<bool>))) std::atomic<bool>{false};
+    constexpr uint64_t count = 100'000;
+    pid_t children[2];
+    for (auto &child : children) {
+      int reader = ring->registerReader();
+      CHECK(reader >= 0);
+      child = inChild([=] {
+        auto feed = Ring::attach(memory);
+        Message msg;
+        uint64_t next = 0;
+        while (true) {
+          auto status = feed->pop(reader, msg);
+          if (status == ReadStatus::Ok) {
+            CHECK(msg.seq >= next && msg.check == msg.seq * 3);
+            next = msg.seq + 1;
+          } else if (status == ReadStatus::Lapped) {
+            feed->resync(reader);
+          } else if (done->load()) {
+            // Caught up after the last push
+            CHECK(feed->backlog(reader) == 0);
+            break;
+          } else {
+            std::this_thread::yield();
+          }
+        }
+        feed->unregisterReader(reader);
+      });
+    }
+    for (uint64_t i = 0; i < count; ++i) {
+      ring->push(Message{i, i * 3});
+      if (i % 64 == 0) {
+        std::this_thread::yield();
+      }
+    }
+    done->store(true);
+    for (auto child : children) {
+      joinChild(child);
+    }
+    ::munmap(done, sizeof(std::atomic<bool>));
+  }
+  ::munmap(memory, sizeof(Ring));
+}
+
+// Fresh directory under /tmp; the caller removes it
+static std::string makeTempDir() {
+  char path[] = "/tmp/smoke_shm.XXXXXX";
+  CHECK(::mkdtemp(path) != nullptr);
+  return path;
+}
+
+static void smokeShmSegment() {
+  constexpr size_t bytes = 3 * 4096 + 1;
+  SegmentOptions options;
+  options.lock = false; // RLIMIT_MEMLOCK is often too small for this
+
+  // A named POSIX segment seen through two mappings, and through a child
+  {
+    std::string name = "/smoke_shm." + std::to_string(::getpid());
+    auto created = ShmSegment::create(name, bytes, options);
+    CHECK(created.data() && created.size() == bytes && created.fd() >= 0);
+    CHECK(!created.locked() && !created.describe().empty());
+    auto opened = ShmSegment::open(name, bytes, options);
+    static_cast<char *>(created.data())[bytes - 1] = 'x';
+    CHECK(static_cast<char *>(opened.data())[bytes - 1] == 'x');
+    CHECK(throws<std::system_error>(
+        [&] { ShmSegment::open(name, bytes + 1, options); }));
+    joinChild(inChild([&] {
+      auto segment = ShmSegment::open(name, bytes, options);
+      CHECK(static_cast<char *>(segment.data())[bytes - 1] == 'x');
+      static_cast<char *>(segment.data())[0] = 'y';
+    }));
+    CHECK(static_cast<char *>(opened.data())[0] == 'y');
+
+    // A moved-from segment no longer owns the mapping
+    ShmSegment moved(std::move(opened));
+    CHECK(opened.data() == nullptr && opened.fd() == -1);
+    CHECK(static_cast<char *>(moved.data())[0] == 'y');
+    ::shm_unlink(name.c_str());
+    CHECK(throws<std::system_error>(
+        [&] { ShmSegment::open(name, bytes, options); }));
+  }
+
+  // A memfd opened through /proc and adopted from a duplicated fd
+  {
+    options.backing = SegmentOptions::Backing::Memfd;
+    auto created = ShmSegment::create("smoke", bytes, options);
+    static_cast<char *>(created.data())[42] = 'm';
+    auto opened = ShmSegment::open(
+        "/proc/self/fd/" + std::to_string(created.fd()), bytes, options);
+    CHECK(static_cast<char *>(opened.data())[42] == 'm');
+    auto adopted =
+        ShmSegment::adopt(::dup(created.fd()), bytes, false, options);
+    CHECK(static_cast<char *>(adopted.data())[42] == 'm');
+  }
+
+  // Huge pages only work with a hugetlb pool; without one create() throws
+  {
+    options.backing = SegmentOptions::Backing::MemfdHugeTlb;
+    try {
+      auto segment = ShmSegment::create("smoke", bytes, options);
+      CHECK(segment.size() == size_t{2} << 20);
+    } catch (const std::system_error &) {
+      // No hugetlb pool configured
+    }
+  }
+
+  // A File keeps its contents across create() once warmUp is off
+  {
+    auto dir = makeTempDir();
+    auto path = dir + "/segment";
+    options.backing = SegmentOptions::Backing::File;
+    {
+      auto segment = ShmSegment::create(path, bytes, options);
+      static_cast<char *>(segment.data())[0] = 'f';
+    }
+    options.warmUp = false;
+    auto segment = ShmSegment::create(path, bytes, options);
+    CHECK(static_cast<char *>(segment.data())[0] == 'f');
+    std::filesystem::remove_all(dir);
+  }
+}
+
+static void smokeJournal() {
+  auto dir = makeTempDir();
+  Message msg;
+  {
+    // Four records per segment, so ten records span three files
+    JournalWriter<Message> writer(dir, 4);
+    for (uint64_t i = 0; i < 10; ++i) {
+      CHECK(writer.append(Message{i, i * 3}) == i);
+    }
+    writer.sync();
+    CHECK(std::filesystem::exists(journal_detail::segmentPath(dir, 8)));
+
+    JournalReader<Message> reader(dir, 0);
+    CHECK(reader.backlog() == 10);
+    for (uint64_t i = 0; i < 10; ++i) {
+      CHECK(reader.read(msg) && msg.seq == i && msg.check == i * 3);
+    }
+    CHECK(!reader.read(msg) && reader.position() == 10);
+    reader.ack(7);
+    CHECK(reader.acked() == 7);
+  }
+
+  // Consumers resume at their own ack after a restart, and can replay
+  {
+    JournalReader<Message> resumed(dir, 0);
+    CHECK(resumed.position() == 7 && resumed.backlog() == 3);
+    JournalReader<Message> fresh(dir, 1);
+    CHECK(fresh.position() == 0);
+    fresh.seek(5);
+    CHECK(fresh.read(msg) && msg.seq == 5);
+    CHECK(throws<std::out_of_range>([&] { fresh.seek(11); }));
+    CHECK(throws<std::out_of_range>(
+        [&] { JournalReader<Message>(dir, JournalIndex::MAX_CONSUMERS); }));
+    CHECK(throws<std::runtime_error>([&] { JournalWriter<uint32_t>{dir}; }));
+    CHECK(throws<std::runtime_error>([&] { JournalReader<uint32_t>(dir, 0); }));
+  }
+
+  // A restarted writer continues the sequence; trimming drops whole files
+  {
+    JournalWriter<Message> writer(dir);
+    CHECK(writer.nextSeq() == 10 && writer.append(Message{10, 30}) == 10);
+    JournalReader<Message> stale(dir, 3);
+    writer.trimBefore(9);
+    CHECK(throws<std::out_of_range>([&] { stale.read(msg); }));
+    stale.seek(8);
+    CHECK(stale.read(msg) && msg.seq == 8);
+    CHECK(!std::filesystem::exists(journal_detail::segmentPath(dir, 4)));
+    CHECK(std::filesystem::exists(journal_detail::segmentPath(dir, 8)));
+    JournalReader<Message> reader(dir, 2);
+    CHECK(reader.position() == 8);
+    CHECK(throws<std::out_of_range>([&] { reader.seek(7); }));
+    reader.seek(10);
+    CHECK(reader.read(msg) && msg.seq == 10);
+  }
+  std::filesystem::remove_all(dir);
+
+  // A reader follows a writer in another process live
+  dir = makeTempDir();
+  constexpr uint64_t count = 10'000;
+  JournalWriter<Message>(dir, 1024).sync(); // create the index up front
+  pid_t child = inChild([&] {
+    JournalWriter<Message> writer(dir);
+    for (uint64_t i = 0; i < count; ++i) {
+      writer.append(Message{i, i * 3});
+    }
+  });
+  JournalReader<Message> reader(dir, 0);
+  for (uint64_t i = 0; i < count;) {
+    if (!reader.read(msg)) {
+      std::this_thread::yield();
+      continue;
+    }
+    CHECK(msg.seq == i && msg.check == i * 3);
+    ++i;
+  }
+  reader.ack();
+  CHECK(reader.acked() == count);
+  joinChild(child);
+  std::filesystem::remove_all(dir);
+}
+
+static void smokeChannelBroker() {
+  auto socketPath = "@smoke_shm." + std::to_string(::getpid());
+  ChannelBroker broker(socketPath);
+  std::thread server([&] { broker.run(); });
+  SegmentOptions options;
+  options.lock = false;
+
+  // Every asker of a name maps the same memory until the last one lets go
+  {
+    bool created = false;
+    auto first = requestChannel(socketPath, "bytes", 4096, options, &created);
+    CHECK(created && first.size() >= 4096);
+    auto second = requestChannel(socketPath, "bytes", 4096, options, &created);
+    CHECK(!created && broker.channels() == 1);
+    static_cast<char *>(first.data())[7] = 'c';
+    CHECK(static_cast<char *>(second.data())[7] == 'c');
+    releaseChannel(socketPath, "bytes");
+    CHECK(broker.channels() == 1);
+    releaseChannel(socketPath, "bytes");
+    CHECK(broker.channels() == 0);
+    requestChannel(socketPath, "bytes", 4096, options, &created);
+    CHECK(created);
+    releaseChannel(socketPath, "bytes");
+  }
+
+  // A typed ring shared with a child through the broker; both leases
+  // release it when they go
+  {
+    using Ring = ShmRing<Message, 8>;
+    auto channel = openChannel<Ring>(socketPath, "ring", options);
+    constexpr uint64_t count = 10'000;
+    pid_t child = inChild([&] {
+      auto producer = openChannel<Ring>(socketPath, "ring", options);
+      for (uint64_t i = 0; i < count; ++i) {
+        while (!producer.ring->push(Message{i, i * 3})) {
+          std::this_thread::yield();
+        }
+      }
+    });
+    Message msg;
+    for (uint64_t i = 0; i < count;) {
+      if (!channel.ring->pop(msg)) {
+        std::this_thread::yield();
+        continue;
+      }
+      CHECK(msg.seq == i && msg.check == i * 3);
+      ++i;
+    }
+    joinChild(child);
+  }
+  CHECK(broker.channels() == 0);
+
+  // A holder that exits without releasing is reaped
+  joinChild(inChild([&] {
+    requestChannel(socketPath, "orphan", 4096, options);
+  }));
+  broker.reap();
+  CHECK(broker.channels() == 0);
+
+  broker.stop();
+  server.join();
+}
+
+int main() {
+  smokeShmRing();
+  smokeShmRingWait();
+  smokeShmRingInPlace();
+  smokeShmBroadcastRing();
+  smokeShmSegment();
+  smokeJournal();
+  smokeChannelBroker();
+  std::puts("smoke_shm: ok");
+}
@@ -0,0 +1,60 @@
+#include <benchmark/benchmark.h>
+#include "mpmc_q.cpp"
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+static constexpr std::size_t kCapacity = 1024;
+static constexpr std::uint64_t kItems = 1 << 20;
+
+// Moves kItems through one MpmcFifo with range(0) producers and range(1)
+// consumers; items_per_second shows how throughput scales with both.
+static void BM_MpmcScaling(benchmark::State& state) {
+  auto const producers = static_cast<std::uint64_t>(state.range(0));
+  auto const consumers = static_cast<std::uint64_t>(state.range(1));
+
+  for (auto _ : state) {
+    MpmcFifo<std::uint64_t> fifo(kCapacity);
+    std::vector<std::thread> threads;
+
+    for (std::uint64_t p = 0; p < producers; ++p) {
+      threads.emplace_back([&, p] {
+        // Producer p sends every producers-th item
+        for (auto i = p; i < kItems; i += producers) {
+          while (not fifo.push(i)) {
+            std::this_thread::yield();
+          }
+        }
+      });
+    }
+    for (std::uint64_t c = 0; c < consumers; ++c) {
+      threads.emplace_back([&, c] {
+        // Consumer c takes a fixed share, so pops share no counter; the
+        // first kItems % consumers consumers take one extra item
+        auto quota = kItems / consumers + (c < kItems % consumers ? 1 : 0);
+        std::uint64_t value;
+        while (quota != 0) {
+          if (fifo.pop(value)) {
+            --quota;
+            benchmark::DoNotOptimize(value);
+          } else {
+            std::this_thread::yield();
+          }
+        }
+      });
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * kItems);
+}
+
+BENCHMARK(BM_MpmcScaling)
+    ->ArgNames({"producers", "consumers"})
+    ->ArgsProduct({{1, 2, 4, 8}, {1, 2, 4, 8}})
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_MAIN();
@@ -0,0 +1,237 @@
+#include <benchmark/benchmark.h>
+#include "spsc_q1.cpp"
+#include "spsc_q2.cpp"
+#include "spsc_q3.cpp"
+#include "spsc_q3_fixed.cpp"
+#include "spsc_q4.cpp"
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Cores for the two sides of every two-thread benchmark; -1 leaves the
+// thread unpinned. Choose same core, SMT siblings or cores on different
+// sockets with --producer_cpu=N --consumer_cpu=M.
+static int producerCpu = -1;
+static int consumerCpu = -1;
+
+static void pin(pthread_t thread, int cpu) {
+  if (cpu < 0) {
+    return;
+  }
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  ::pthread_setaffinity_np(thread, sizeof(set), &set);
+}
+
+// Restores the calling thread's affinity when it goes out of scope, so a
+// threaded benchmark that pins the runner thread does not leave every
+// later benchmark on that core.
+class AffinityGuard {
+public:
+  AffinityGuard() {
+    CPU_ZERO(&saved_);
+    ::pthread_getaffinity_np(::pthread_self(), sizeof(saved_), &saved_);
+  }
+  ~AffinityGuard() {
+    ::pthread_setaffinity_np(::pthread_self(), sizeof(saved_), &saved_);
+  }
+  AffinityGuard(AffinityGuard const&) = delete;
+  AffinityGuard& operator=(AffinityGuard const&) = delete;
+
+private:
+  cpu_set_t saved_;
+};
+
+// Busy-waits with a pause instruction, then yields so that both sides
+// still make progress when they are pinned to the same core.
+struct Backoff {
+  unsigned spins = 0;
+
+  void operator()() {
+    if (++spins < 128) {
+#if defined(__x86_64__) || defined(__i386__)
+      __builtin_ia32_pause();
+#endif
+    } else {
+      std::this_thread::yield();
+    }
+  }
+};
+
+template<std::size_t Size>
+struct Payload {
+  std::array<char, Size> bytes;
+};
+
+template<typename Fifo>
+static auto makeFifo(std::size_t capacity) {
+  if constexpr (requires { Fifo{capacity}; }) {
+    return std::make_unique<Fifo>(capacity);
+  } else {
+    return std::make_unique<Fifo>();
+  }
+}
+
+// Push and pop on one thread: isolates the cost of the index arithmetic
+// and the ring access from any cross-core traffic. This is the only
+// benchmark Fifo1 takes part in, since it is not threadsafe.
+template<typename Fifo>
+static void BM_PushPop(benchmark::State& state) {
+  auto fifo = makeFifo<Fifo>(state.range(0));
+  typename Fifo::value_type value{};
+  for (auto _ : state) {
+    fifo->push(value);
+    fifo->pop(value);
+    benchmark::DoNotOptimize(value);
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(state.iterations() * sizeof(value));
+}
+
+// Producer on a second thread, consumer on the benchmark thread.
+template<typename Fifo>
+static void BM_Throughput(benchmark::State& state) {
+  auto fifo = makeFifo<Fifo>(state.range(0));
+  AffinityGuard affinity;
+  pin(::pthread_self(), consumerCpu);
+  std::thread producer([&fifo, n = state.max_iterations] {
+    typename Fifo::value_type value{};
+    for (benchmark::IterationCount i = 0; i < n; ++i) {
+      Backoff backoff;
+      while (not fifo->push(value)) {
+        backoff();
+      }
+    }
+  });
+  pin(producer.native_handle(), producerCpu);
+
+  typename Fifo::value_type value{};
+  for (auto _ : state) {
+    Backoff backoff;
+    while (not fifo->pop(value)) {
+      backoff();
+    }
+    benchmark::DoNotOptimize(value);
+  }
+  producer.join();
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(state.iterations() * sizeof(value));
+}
+
+// One element goes out on `ping` and is echoed back on `pong`; reports
+// round-trip percentiles in nanoseconds.
+template<typename Fifo>
+static void BM_PingPong(benchmark::State& state) {
+  auto ping = makeFifo<Fifo>(state.range(0));
+  auto pong = makeFifo<Fifo>(state.range(0));
+  std::atomic<bool> stop{false};
+  AffinityGuard affinity;
+  pin(::pthread_self(), producerCpu);
+  std::thread echo([&] {
+    typename Fifo::value_type value{};
+    Backoff backoff;
+    while (not stop.load(std::memory_order_relaxed)) {
+      if (ping->pop(value)) {
+        while (not pong->push(value)) {
+          backoff();
+        }
+        backoff = {};
+      } else {
+        backoff();
+      }
+    }
+  });
+  pin(echo.native_handle(), consumerCpu);
+
+  std::vector<std::int64_t> rtt;
+  rtt.reserve(state.max_iterations);
+  typename Fifo::value_type value{};
+  for (auto _ : state) {
+    auto start = std::chrono::steady_clock::now();
+    Backoff backoff;
+    while (not ping->push(value)) {
+      backoff();
+    }
+    while (not pong->pop(value)) {
+      backoff();
+    }
+    rtt.push_back((std::chrono::steady_clock::now() - start).count());
+  }
+  stop.store(true, std::memory_order_relaxed);
+  echo.join();
+
+  std::sort(rtt.begin(), rtt.end());
+  auto percentile = [&rtt](double p) {
+    return static_cast<double>(rtt[static_cast<std::size_t>(p * (rtt.size() - 1))]);
+  };
+  state.counters["p50_ns"] = percentile(0.50);
+  state.counters["p99_ns"] = percentile(0.99);
+  state.counters["p99.9_ns"] = percentile(0.999);
+}
+
+static const std::vector<std::int64_t> kCapacities = {64, 1024, 65536};
+
+template<typename Fifo>
+static void registerThreaded(std::string const& name, std::vector<std::int64_t> const& capacities) {
+  for (auto capacity : capacities) {
+    benchmark::RegisterBenchmark((name + "/Throughput").c_str(), BM_Throughput<Fifo>)
+        ->ArgName("capacity")->Arg(capacity)->UseRealTime();
+    benchmark::RegisterBenchmark((name + "/PingPong").c_str(), BM_PingPong<Fifo>)
+        ->ArgName("capacity")->Arg(capacity)->UseRealTime();
+  }
+}
+
+template<std::size_t Size>
+static void registerPayload() {
+  using P = Payload<Size>;
+  auto const suffix = "<" + std::to_string(Size) + "B>";
+
+  benchmark::RegisterBenchmark(("Fifo1" + suffix + "/PushPop").c_str(), BM_PushPop<Fifo1<P>>)
+      ->ArgName("capacity")->Arg(1024);
+  benchmark::RegisterBenchmark(("Fifo3" + suffix + "/PushPop").c_str(), BM_PushPop<Fifo3<P>>)
+      ->ArgName("capacity")->Arg(1024);
+  benchmark::RegisterBenchmark(("FixedFifo3" + suffix + "/PushPop").c_str(), BM_PushPop<FixedFifo3<P, 1024>>)
+      ->ArgName("capacity")->Arg(1024);
+
+  registerThreaded<Fifo2<P>>("Fifo2" + suffix, kCapacities);
+  registerThreaded<Fifo3<P>>("Fifo3" + suffix, kCapacities);
+  registerThreaded<Fifo4<P>>("Fifo4" + suffix, kCapacities);
+  registerThreaded<FixedFifo3<P, 1024>>("FixedFifo3" + suffix, {1024});
+}
+
+int main(int argc, char** argv) {
+  benchmark::Initialize(&argc, argv);
+  for (int i = 1; i < argc; ++i) {
+    if (std::strncmp(argv[i], "--producer_cpu=", 15) == 0) {
+      producerCpu = std::atoi(argv[i] + 15);
+    } else if (std::strncmp(argv[i], "--consumer_cpu=", 15) == 0) {
+      consumerCpu = std::atoi(argv[i] + 15);
+    } else {
+      benchmark::ReportUnrecognizedArguments(argc, argv);
+      return 1;
+    }
+  }
+
+  registerPayload<4>();
+  registerPayload<16>();
+  registerPayload<64>();
+  registerPayload<128>();
+  registerPayload<256>();
+  registerPayload<512>();
+
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include "spsc_q4.cpp"
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+
+/// Threadsafe "latest value" table for one producer and one consumer
+///
+/// Holds one seqlock-protected slot per symbol id plus a Fifo4 of symbols
+/// that changed since the consumer last looked. A symbol is queued at most
+/// once however often it is updated, so a pass over the changes costs at
+/// most one read per symbol rather than one per message. Values are copied
+/// in and out with memcpy, hence the trivially copyable requirement; the
+/// MarketData struct from L1/mocks/MarketFeed.cpp qualifies.
+template<typename T, typename Alloc = std::allocator<T>>
+class ConflatingQueue
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+
+    // See Fifo3 for why std::hardware_destructive_interference_size is not used
+    static constexpr auto hardware_destructive_interference_size = std::size_t{64};
+
+    struct alignas(hardware_destructive_interference_size) Slot
+    {
+        /// Odd while the producer is writing `value`
+        std::atomic<std::uint32_t> sequence{};
+        /// Set by the producer when it queues the symbol; cleared by the consumer
+        std::atomic<bool> dirty{};
+        T value{};
+    };
+
+    using SlotAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<Slot>;
+    using SymbolAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<std::uint32_t>;
+
+public:
+    using value_type = T;
+    using allocator_traits = std::allocator_traits<SlotAlloc>;
+    using size_type = typename allocator_traits::size_type;
+    using symbol_type = std::uint32_t;
+
+    explicit ConflatingQueue(size_type symbols, Alloc const& alloc = Alloc{})
+        : alloc_{alloc}
+        , symbols_{symbols}
+        , slots_{allocator_traits::allocate(alloc_, symbols)}
+        , dirty_{symbols, SymbolAlloc{alloc}}
+    {
+        for (size_type i = 0; i < symbols_; ++i) {
+            allocator_traits::construct(alloc_, &slots_[i]);
+        }
+    }
+
+    ConflatingQueue(ConflatingQueue const&) = delete;
+    ConflatingQueue& operator=(ConflatingQueue const&) = delete;
+    ConflatingQueue(ConflatingQueue&&) = delete;
+    ConflatingQueue& operator=(ConflatingQueue&&) = delete;
+
+    ~ConflatingQueue() {
+        for (size_type i = 0; i < symbols_; ++i) {
+            allocator_traits::destroy(alloc_, &slots_[i]);
+        }
+        allocator_traits::deallocate(alloc_, slots_, symbols_);
+    }
+
+
+    /// Returns the number of symbols
+    auto symbols() const noexcept { return symbols_; }
+
+    /// Returns the number of symbols changed since the consumer last saw them
+    auto pending() const noexcept { return dirty_.size(); }
+
+
+    /// Producer: replace the latest value of `symbol`.
+    void update(symbol_type symbol, T const& value) noexcept {
+        assert(symbol < symbols_);
+        auto& slot = slots_[symbol];
+        auto sequence = slot.sequence.load(std::memory_order_relaxed);
+        slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(&slot.value, &value, sizeof(T));
+        slot.sequence.store(sequence + 2, std::memory_order_release);
+
+        if (not slot.dirty.exchange(true, std::memory_order_acq_rel)) {
+            // Cannot fail: each symbol is queued at most once
+            [[maybe_unused]] auto pushed = dirty_.push(symbol);
+            assert(pushed);
+        }
+    }
+
+    /// Consumer: take the next changed symbol and its latest value.
+    /// @return `true` if a symbol had changed; `false` if none had.
+    auto poll(symbol_type& symbol, T& value) noexcept {
+        if (not dirty_.pop(symbol)) {
+            return false;
+        }
+        // Cleared before reading, so an update racing with the read queues
+        // the symbol again instead of being lost.
+        slots_[symbol].dirty.exchange(false, std::memory_order_acq_rel);
+        read(symbol, value);
+        return true;
+    }
+
+    /// Consumer: call `fn(symbol, value)` once for every symbol that changed
+    /// before the call; symbols updated during the pass wait for the next one.
+    /// @return the number of symbols visited.
+    template<typename Fn>
+    size_type drain(Fn&& fn) {
+        auto pending = dirty_.size();
+        symbol_type symbol;
+        T value;
+        size_type visited = 0;
+        while (visited < pending and poll(symbol, value)) {
+            fn(symbol, value);
+            ++visited;
+        }
+        return visited;
+    }
+
+    /// Any thread: copy the latest value of `symbol` regardless of whether it
+    /// changed.
+    void read(symbol_type symbol, T& value) const noexcept {
+        assert(symbol < symbols_);
+        auto const& slot = slots_[symbol];
+        while (true) {
+            auto before = slot.sequence.load(std::memory_order_acquire);
+            if (before & 1) {
+                continue;
+            }
+            std::memcpy(&value, &slot.value, sizeof(T));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.sequence.load(std::memory_order_relaxed) == before) {
+                return;
+            }
+        }
+    }
+
+private:
+    SlotAlloc alloc_;
+    size_type symbols_;
+    Slot* slots_;
+    Fifo4<symbol_type, SymbolAlloc> dirty_;
+};
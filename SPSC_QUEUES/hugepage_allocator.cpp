@@ -0,0 +1,121 @@
+#pragma once
+
+#include <linux/mempolicy.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <iterator>
+#include <new>
+#include <system_error>
+#include <type_traits>
+
+
+/// How HugePageAllocator backs an allocation
+struct HugePageOptions
+{
+    /// NUMA node to bind the pages to; -1 leaves placement to the kernel
+    int numaNode = -1;
+    /// Touch every page up front so the hot path takes no first-touch faults
+    bool prefault = true;
+    /// mlock the pages so they are never swapped out; RLIMIT_MEMLOCK must
+    /// cover every ring allocated this way
+    bool lock = true;
+};
+
+
+/// Allocator for the Fifo `Alloc` parameter that backs rings with 2MB pages
+///
+/// Tries an explicit MAP_HUGETLB mapping first and falls back to normal pages
+/// with a transparent huge page hint when the hugetlb pool is empty. The
+/// mapping is bound to a NUMA node before it is touched, so prefaulting
+/// places every page there. Every allocation is rounded up to a whole huge
+/// page, which makes this allocator a fit for large, long-lived rings only.
+/// allocate() throws std::system_error if the requested NUMA binding or
+/// mlock fails, rather than hand out memory without them. Any instance can
+/// free what another allocated, so all instances compare equal.
+template<typename T>
+class HugePageAllocator
+{
+public:
+    using value_type = T;
+    using is_always_equal = std::true_type;
+
+    static constexpr std::size_t hugePageSize = std::size_t{2} << 20;
+
+    HugePageAllocator() noexcept = default;
+
+    explicit HugePageAllocator(HugePageOptions options) noexcept
+        : options_{options}
+    {}
+
+    template<typename U>
+    HugePageAllocator(HugePageAllocator<U> const& other) noexcept
+        : options_{other.options()}
+    {}
+
+    auto options() const noexcept { return options_; }
+
+    T* allocate(std::size_t n) {
+        auto length = mappingLength(n);
+        auto memory = ::mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (memory == MAP_FAILED) {
+            memory = ::mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (memory == MAP_FAILED) {
+                throw std::bad_alloc{};
+            }
+            ::madvise(memory, length, MADV_HUGEPAGE);
+        }
+
+        if (options_.numaNode >= 0) {
+            unsigned long nodeMask[4] = {};
+            constexpr auto bitsPerWord = 8 * sizeof(unsigned long);
+            constexpr auto maskBits = bitsPerWord * std::size(nodeMask);
+            if (static_cast<std::size_t>(options_.numaNode) >= maskBits) {
+                fail(memory, length, EINVAL, "HugePageAllocator: NUMA node out of range");
+            }
+            nodeMask[options_.numaNode / bitsPerWord] = 1ul << (options_.numaNode % bitsPerWord);
+            // The kernel reads maxnode - 1 bits of the mask
+            if (::syscall(SYS_mbind, memory, length, MPOL_BIND, nodeMask, maskBits + 1, MPOL_MF_MOVE) != 0) {
+                fail(memory, length, errno, "HugePageAllocator: mbind");
+            }
+        }
+
+        if (options_.prefault) {
+            // One write per 4KB page also covers the fallback mapping
+            auto bytes = static_cast<volatile char*>(memory);
+            for (std::size_t offset = 0; offset < length; offset += 4096) {
+                bytes[offset] = 0;
+            }
+        }
+        if (options_.lock and ::mlock(memory, length) != 0) {
+            fail(memory, length, errno, "HugePageAllocator: mlock");
+        }
+        return static_cast<T*>(memory);
+    }
+
+    void deallocate(T* p, std::size_t n) noexcept {
+        ::munmap(p, mappingLength(n));
+    }
+
+    template<typename U>
+    friend bool operator==(HugePageAllocator const&, HugePageAllocator<U> const&) noexcept {
+        return true;
+    }
+
+private:
+    [[noreturn]] static void fail(void* memory, std::size_t length, int error, char const* what) {
+        ::munmap(memory, length);
+        throw std::system_error(error, std::generic_category(), what);
+    }
+
+    static auto mappingLength(std::size_t n) noexcept {
+        return (n * sizeof(T) + hugePageSize - 1) & ~(hugePageSize - 1);
+    }
+
+    HugePageOptions options_;
+};
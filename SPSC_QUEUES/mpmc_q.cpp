@@ -0,0 +1,168 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+
+/// Threadsafe bounded circular FIFO for multiple producers and consumers
+///
+/// Same push/pop/capacity surface as Fifo3. Every slot carries a sequence
+/// number telling whose turn it is: a producer may fill slot `pos` when its
+/// sequence equals `pos`, a consumer may drain it when the sequence equals
+/// `pos + 1`. Threads on the same side race for a cursor with a CAS; the two
+/// sides only meet on the slot they hand over.
+template<typename T, typename Alloc = std::allocator<T>>
+class MpmcFifo
+{
+    using CursorType = std::atomic<std::size_t>;
+    static_assert(CursorType::is_always_lock_free);
+
+    struct Slot
+    {
+        /// Stored by whichever side finished with the slot last
+        CursorType sequence;
+        alignas(T) std::byte storage[sizeof(T)];
+
+        auto element() noexcept { return reinterpret_cast<T*>(storage); }
+    };
+
+    using SlotAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<Slot>;
+
+public:
+    using value_type = T;
+    using allocator_traits = std::allocator_traits<SlotAlloc>;
+    using size_type = typename allocator_traits::size_type;
+
+    explicit MpmcFifo(size_type capacity, Alloc const& alloc = Alloc{})
+        : alloc_{alloc}
+        , capacity_{capacity}
+        , ring_{allocator_traits::allocate(alloc_, capacity)}
+    {
+        for (size_type i = 0; i < capacity_; ++i) {
+            new (&ring_[i].sequence) CursorType{i};
+        }
+    }
+
+    MpmcFifo(MpmcFifo const&) = delete;
+    MpmcFifo& operator=(MpmcFifo const&) = delete;
+    MpmcFifo(MpmcFifo&&) = delete;
+    MpmcFifo& operator=(MpmcFifo&&) = delete;
+
+    ~MpmcFifo() {
+        auto pushCursor = pushCursor_.load(std::memory_order_relaxed);
+        for (auto popCursor = popCursor_.load(std::memory_order_relaxed); popCursor != pushCursor; ++popCursor) {
+            slot(popCursor).element()->~T();
+        }
+        for (size_type i = 0; i < capacity_; ++i) {
+            ring_[i].sequence.~CursorType();
+        }
+        allocator_traits::deallocate(alloc_, ring_, capacity_);
+    }
+
+
+    /// Returns the number of elements in the fifo; approximate while other
+    /// threads are pushing or popping
+    auto size() const noexcept {
+        auto popCursor = popCursor_.load(std::memory_order_relaxed);
+        auto pushCursor = pushCursor_.load(std::memory_order_relaxed);
+        return pushCursor > popCursor ? pushCursor - popCursor : size_type{0};
+    }
+
+    /// Returns whether the container has no elements
+    auto empty() const noexcept { return size() == 0; }
+
+    /// Returns whether the container has capacity_() elements
+    auto full() const noexcept { return size() >= capacity(); }
+
+    /// Returns the number of elements that can be held in the fifo
+    auto capacity() const noexcept { return capacity_; }
+
+
+    /// Push one object onto the fifo.
+    /// @return `true` if the operation is successful; `false` if fifo is full.
+    auto push(T const& value) {
+        return emplace(value);
+    }
+
+    /// Push one object onto the fifo, moving from `value`.
+    /// @return `true` if the operation is successful; `false` if fifo is full.
+    auto push(T&& value) {
+        return emplace(std::move(value));
+    }
+
+    /// Construct one object in place at the back of the fifo.
+    /// @return `true` if the operation is successful; `false` if fifo is full.
+    template<typename... Args>
+    auto emplace(Args&&... args) {
+        auto pushCursor = pushCursor_.load(std::memory_order_relaxed);
+        while (true) {
+            auto& s = slot(pushCursor);
+            auto diff = distance(s.sequence.load(std::memory_order_acquire), pushCursor);
+            if (diff == 0) {
+                if (pushCursor_.compare_exchange_weak(pushCursor, pushCursor + 1, std::memory_order_relaxed)) {
+                    new (s.element()) T(std::forward<Args>(args)...);
+                    s.sequence.store(pushCursor + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                // The slot still holds the element from one lap ago
+                return false;
+            } else {
+                pushCursor = pushCursor_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /// Pop one object from the fifo.
+    /// @return `true` if the pop operation is successful; `false` if fifo is empty.
+    auto pop(T& value) {
+        auto popCursor = popCursor_.load(std::memory_order_relaxed);
+        while (true) {
+            auto& s = slot(popCursor);
+            auto diff = distance(s.sequence.load(std::memory_order_acquire), popCursor + 1);
+            if (diff == 0) {
+                if (popCursor_.compare_exchange_weak(popCursor, popCursor + 1, std::memory_order_relaxed)) {
+                    value = std::move(*s.element());
+                    s.element()->~T();
+                    s.sequence.store(popCursor + capacity_, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                // The slot has not been filled for this lap yet
+                return false;
+            } else {
+                popCursor = popCursor_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+private:
+    static auto distance(size_type sequence, size_type cursor) noexcept {
+        return static_cast<std::make_signed_t<size_type>>(sequence - cursor);
+    }
+    auto& slot(size_type cursor) noexcept {
+        return ring_[cursor % capacity_];
+    }
+
+private:
+    SlotAlloc alloc_;
+    size_type capacity_;
+    Slot* ring_;
+
+    // See Fifo3 for why std::hardware_destructive_interference_size is not used
+    static constexpr auto hardware_destructive_interference_size = size_type{64};
+
+    /// Claimed with a CAS by push threads
+    alignas(hardware_destructive_interference_size) CursorType pushCursor_{};
+
+    /// Claimed with a CAS by pop threads
+    alignas(hardware_destructive_interference_size) CursorType popCursor_{};
+
+    // Padding to avoid false sharing with adjacent objects
+    char padding_[hardware_destructive_interference_size - sizeof(size_type)];
+};
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <thread>
+#include <utility>
+
+
+/// Threadsafe bounded circular FIFO for many producers and one consumer
+///
+/// Producers claim a slot with a single fetch_add on the push cursor and
+/// publish it through the slot's sequence number. The consumer owns the pop
+/// cursor outright and never needs a CAS: it reads the next slot once its
+/// sequence says it has been filled.
+template<typename T, typename Alloc = std::allocator<T>>
+class MpscFifo
+{
+    using CursorType = std::atomic<std::size_t>;
+    static_assert(CursorType::is_always_lock_free);
+
+    struct Slot
+    {
+        /// `pos` when free for push `pos`, `pos + 1` once filled by it
+        CursorType sequence;
+        alignas(T) std::byte storage[sizeof(T)];
+
+        auto element() noexcept { return reinterpret_cast<T*>(storage); }
+    };
+
+    using SlotAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<Slot>;
+
+public:
+    using value_type = T;
+    using allocator_traits = std::allocator_traits<SlotAlloc>;
+    using size_type = typename allocator_traits::size_type;
+
+    explicit MpscFifo(size_type capacity, Alloc const& alloc = Alloc{})
+        : alloc_{alloc}
+        , capacity_{capacity}
+        , ring_{allocator_traits::allocate(alloc_, capacity)}
+    {
+        for (size_type i = 0; i < capacity_; ++i) {
+            new (&ring_[i].sequence) CursorType{i};
+        }
+    }
+
+    MpscFifo(MpscFifo const&) = delete;
+    MpscFifo& operator=(MpscFifo const&) = delete;
+    MpscFifo(MpscFifo&&) = delete;
+    MpscFifo& operator=(MpscFifo&&) = delete;
+
+    ~MpscFifo() {
+        auto pushCursor = pushCursor_.load(std::memory_order_relaxed);
+        for (auto popCursor = popCursor_.load(std::memory_order_relaxed); popCursor != pushCursor; ++popCursor) {
+            slot(popCursor).element()->~T();
+        }
+        for (size_type i = 0; i < capacity_; ++i) {
+            ring_[i].sequence.~CursorType();
+        }
+        allocator_traits::deallocate(alloc_, ring_, capacity_);
+    }
+
+
+    /// Returns the number of elements in the fifo, including slots claimed
+    /// by producers that are still being written
+    auto size() const noexcept {
+        auto popCursor = popCursor_.load(std::memory_order_relaxed);
+        auto pushCursor = pushCursor_.load(std::memory_order_relaxed);
+        return pushCursor > popCursor ? pushCursor - popCursor : size_type{0};
+    }
+
+    /// Returns whether the container has no elements
+    auto empty() const noexcept { return size() == 0; }
+
+    /// Returns whether the container has capacity_() elements
+    auto full() const noexcept { return size() >= capacity(); }
+
+    /// Returns the number of elements that can be held in the fifo
+    auto capacity() const noexcept { return capacity_; }
+
+
+    /// Push one object onto the fifo.
+    /// Not wait-free: may block (yield) while the ring is at capacity; see emplace().
+    /// @return `true` if the operation is successful; `false` if fifo is full.
+    auto push(T const& value) {
+        return emplace(value);
+    }
+
+    /// Push one object onto the fifo, moving from `value`.
+    /// Not wait-free: may block (yield) while the ring is at capacity; see emplace().
+    /// @return `true` if the operation is successful; `false` if fifo is full.
+    auto push(T&& value) {
+        return emplace(std::move(value));
+    }
+
+    /// Construct one object in place at the back of the fifo.
+    /// Not wait-free: the full check and the fetch_add claim are separate, so
+    /// racing producers can claim cursors past capacity. Such a producer does
+    /// not fail; it blocks, yielding, until the consumer frees its slot. Only a
+    /// producer that sees the ring full before claiming gets `false`.
+    /// @return `true` if the operation is successful; `false` if fifo is full.
+    template<typename... Args>
+    auto emplace(Args&&... args) {
+        auto popCursor = popCursor_.load(std::memory_order_acquire);
+        if (pushCursor_.load(std::memory_order_relaxed) - popCursor >= capacity_) {
+            return false;
+        }
+        auto pushCursor = pushCursor_.fetch_add(1, std::memory_order_relaxed);
+        auto& s = slot(pushCursor);
+        while (s.sequence.load(std::memory_order_acquire) != pushCursor) {
+            std::this_thread::yield();
+        }
+        new (s.element()) T(std::forward<Args>(args)...);
+        s.sequence.store(pushCursor + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// Pop one object from the fifo.
+    /// @return `true` if the pop operation is successful; `false` if fifo is
+    /// empty or the oldest claimed slot is still being written.
+    auto pop(T& value) {
+        auto popCursor = popCursor_.load(std::memory_order_relaxed);
+        auto& s = slot(popCursor);
+        if (s.sequence.load(std::memory_order_acquire) != popCursor + 1) {
+            return false;
+        }
+        value = std::move(*s.element());
+        s.element()->~T();
+        s.sequence.store(popCursor + capacity_, std::memory_order_release);
+        popCursor_.store(popCursor + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    auto& slot(size_type cursor) noexcept {
+        return ring_[cursor % capacity_];
+    }
+
+private:
+    SlotAlloc alloc_;
+    size_type capacity_;
+    Slot* ring_;
+
+    // See Fifo3 for why std::hardware_destructive_interference_size is not used
+    static constexpr auto hardware_destructive_interference_size = size_type{64};
+
+    /// Claimed with fetch_add by the push threads; loaded by the pop thread
+    alignas(hardware_destructive_interference_size) CursorType pushCursor_{};
+
+    /// Loaded and stored by the pop thread; loaded by the push threads
+    alignas(hardware_destructive_interference_size) CursorType popCursor_{};
+
+    // Padding to avoid false sharing with adjacent objects
+    char padding_[hardware_destructive_interference_size - sizeof(size_type)];
+};
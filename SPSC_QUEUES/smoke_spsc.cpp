@@ -0,0 +1,817 @@
+// Instantiates every queue in this directory with its full API and checks
+// basic behaviour, single-threaded and across threads. Built with
+// the benchmarks so that a template that stops compiling breaks the build;
+// run it to catch a queue that loses or reorders elements.
+#include "spsc_q3.cpp"
+#include "spsc_q4.cpp"
+#include "spsc_q3_fixed.cpp"
+#include "spsc_q3_blocking.cpp"
+#include "mpmc_q.cpp"
+#include "mpsc_q.cpp"
+#include "spmc_broadcast.cpp"
+#include "spsc_pipeline.cpp"
+#include "spsc_unbounded.cpp"
+#include "conflating_q.cpp"
+#include "spsc_bytes.cpp"
+#include "hugepage_allocator.cpp"
+#include "spsc_coro.cpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+// Unlike assert(), stays active in Release builds
+#define CHECK(cond)                                                        \
+  do {                                                                     \
+    if (not(cond)) {                                                       \
+      std::fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, \
+                   #cond);                                                 \
+      std::abort();                                                        \
+    }                                                                      \
+  } while (0)
+
+// Runs `producer` on a second thread while `consumer` runs on this one
+template<typename Producer, typename Consumer>
+static void onTwoThreads(Producer producer, Consumer consumer) {
+  std::thread thread(producer);
+  consumer();
+  thread.join();
+}
+
+template<typename Exception, typename Fn>
+static bool throws(Fn fn) {
+  try {
+    fn();
+  } catch (Exception const&) {
+    return true;
+  }
+  return false;
+}
+
+// `fifo` must hold ints and have a capacity of 8
+template<typename Fifo>
+static void smokeBulk(Fifo& fifo) {
+  std::array<int, 6> in{1, 2, 3, 4, 5, 6};
+  std::array<int, 6> out{};
+  // Offset the cursors so the bulk copies wrap around the end of the ring
+  for (int i = 0; i < 5; ++i) {
+    CHECK(fifo.push(i));
+    int value;
+    CHECK(fifo.pop(value) and value == i);
+  }
+  CHECK(fifo.push_n(in.begin(), 6) == 6);
+  CHECK(fifo.push_n(in.begin(), 6) == 2);
+  CHECK(fifo.pop_n(out.begin(), 6) == 6);
+  CHECK(out == in);
+  CHECK(fifo.pop_n(out.begin(), 6) == 2);
+  CHECK(out[0] == 1 and out[1] == 2);
+  CHECK(fifo.empty());
+
+  // Batches of uneven size across threads keep the order intact
+  constexpr int count = 100'000;
+  onTwoThreads(
+      [&] {
+        std::vector<int> batch(7);
+        for (int next = 0; next < count;) {
+          auto n = std::min<int>(batch.size(), count - next);
+          for (int i = 0; i < n; ++i) {
+            batch[i] = next + i;
+          }
+          auto pushed = static_cast<int>(fifo.push_n(batch.begin(), n));
+          if (pushed == 0) {
+            std::this_thread::yield();
+          }
+          // Whatever did not fit is offered again from scratch
+          next += pushed;
+        }
+      },
+      [&] {
+        std::vector<int> batch(5);
+        for (int expected = 0; expected < count;) {
+          auto n = static_cast<int>(fifo.pop_n(batch.begin(), batch.size()));
+          if (n == 0) {
+            std::this_thread::yield();
+          }
+          for (int i = 0; i < n; ++i) {
+            CHECK(batch[i] == expected++);
+          }
+        }
+      });
+}
+
+// Move-only and allocating elements through every in-place entry point;
+// `fifo` must hold unique_ptr<string> and have a capacity of 4
+template<typename Fifo>
+static void smokeInPlace(Fifo& fifo) {
+  CHECK(fifo.push(std::make_unique<std::string>("moved")));
+  CHECK(fifo.emplace(new std::string("emplaced")));
+  auto slot = fifo.reserve();
+  CHECK(slot);
+  new (slot) std::unique_ptr<std::string>(std::make_unique<std::string>("reserved"));
+  fifo.commit();
+  CHECK(fifo.emplace(std::make_unique<std::string>("full")));
+  CHECK(not fifo.emplace(std::make_unique<std::string>("rejected")));
+  CHECK(not fifo.reserve());
+
+  auto front = fifo.front();
+  CHECK(front and **front == "moved");
+  fifo.release();
+  std::unique_ptr<std::string> value;
+  CHECK(fifo.pop(value) and *value == "emplaced");
+  CHECK(fifo.pop(value) and *value == "reserved");
+  CHECK(*fifo.front()->get() == "full");
+  fifo.release();
+  CHECK(not fifo.front());
+  CHECK(not fifo.pop(value));
+}
+
+// A tiny budget sends both sides to park on the futex almost at once
+static void smokeBlockingFifo3() {
+  BlockingFifo3<int> fifo(4, WaitBudget{16, 2});
+  constexpr int count = 50'000;
+  onTwoThreads(
+      [&] {
+        // Start late so the consumer is parked when the first push lands
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        for (int i = 0; i < count; ++i) {
+          if (i % 2) {
+            fifo.wait_push(i);
+          } else {
+            while (not fifo.push(i)) {
+              std::this_thread::yield();
+            }
+          }
+        }
+      },
+      [&] {
+        for (int expected = 0; expected < count; ++expected) {
+          int value = -1;
+          fifo.wait_pop(value);
+          CHECK(value == expected);
+        }
+      });
+  CHECK(fifo.empty());
+}
+
+// Several producers: every element arrives once, in order per producer
+static void smokeMpmcFifo() {
+  {
+    MpmcFifo<std::unique_ptr<std::string>> fifo(2);
+    CHECK(fifo.emplace(std::make_unique<std::string>("a")));
+    CHECK(fifo.push(std::make_unique<std::string>("b")));
+    CHECK(fifo.full() and not fifo.emplace(nullptr));
+    std::unique_ptr<std::string> value;
+    CHECK(fifo.pop(value) and *value == "a");
+    CHECK(fifo.push(std::make_unique<std::string>("c")) and fifo.size() == 2);
+  }
+
+  // Every element reaches exactly one consumer, and each consumer sees a
+  // given producer's elements in order
+  MpmcFifo<std::uint64_t> fifo(16);
+  constexpr std::uint64_t producers = 2;
+  constexpr std::uint64_t consumers = 2;
+  constexpr std::uint64_t perProducer = 20'000;
+  std::atomic<std::uint64_t> received{0};
+  std::vector<std::vector<std::uint64_t>> counts(consumers, std::vector<std::uint64_t>(producers));
+  std::vector<std::thread> threads;
+  for (std::uint64_t p = 0; p < producers; ++p) {
+    threads.emplace_back([&fifo, p] {
+      for (std::uint64_t i = 0; i < perProducer; ++i) {
+        while (not fifo.push(p << 32 | i)) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  for (std::uint64_t c = 0; c < consumers; ++c) {
+    threads.emplace_back([&, c] {
+      std::array<std::int64_t, producers> last;
+      last.fill(-1);
+      while (received.load(std::memory_order_relaxed) < producers * perProducer) {
+        std::uint64_t value;
+        if (not fifo.pop(value)) {
+          std::this_thread::yield();
+          continue;
+        }
+        auto p = value >> 32;
+        auto i = static_cast<std::int64_t>(value & 0xffffffff);
+        CHECK(p < producers and i > last[p]);
+        last[p] = i;
+        ++counts[c][p];
+        received.fetch_add(1, std::memory_order_relaxed);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  for (std::uint64_t p = 0; p < producers; ++p) {
+    std::uint64_t total = 0;
+    for (std::uint64_t c = 0; c < consumers; ++c) {
+      total += counts[c][p];
+    }
+    CHECK(total == perProducer);
+  }
+  CHECK(fifo.empty());
+}
+
+static void smokeMpscFifo() {
+  MpscFifo<std::uint64_t> fifo(16);
+  constexpr std::uint64_t producers = 3;
+  constexpr std::uint64_t perProducer = 20'000;
+  std::vector<std::thread> threads;
+  for (std::uint64_t p = 0; p < producers; ++p) {
+    threads.emplace_back([&fifo, p] {
+      for (std::uint64_t i = 0; i < perProducer; ++i) {
+        while (not fifo.push(p << 32 | i)) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  std::array<std::uint64_t, producers> next{};
+  for (std::uint64_t received = 0; received < producers * perProducer;) {
+    std::uint64_t value;
+    if (not fifo.pop(value)) {
+      std::this_thread::yield();
+      continue;
+    }
+    auto p = value >> 32;
+    CHECK(p < producers and (value & 0xffffffff) == next[p]++);
+    ++received;
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  CHECK(fifo.emplace(std::uint64_t{7}));
+  CHECK(fifo.size() == 1);
+}
+
+static void smokeBroadcastFifo() {
+  // Two gating readers on their own threads each see every element in order
+  {
+    BroadcastFifo<std::uint64_t> fifo(8, 2);
+    CHECK(fifo.readers() == 2);
+    constexpr std::uint64_t count = 50'000;
+    auto reader = [&fifo](std::size_t r) {
+      for (std::uint64_t next = 0; next < count;) {
+        std::uint64_t value;
+        if (not fifo.pop(r, value)) {
+          std::this_thread::yield();
+          continue;
+        }
+        CHECK(value == next++);
+      }
+    };
+    std::thread second(reader, 1);
+    onTwoThreads(
+        [&] {
+          for (std::uint64_t i = 0; i < count; ++i) {
+            while (not fifo.push(i)) {
+              std::this_thread::yield();
+            }
+          }
+        },
+        [&] { reader(0); });
+    second.join();
+    CHECK(fifo.empty(0) and fifo.empty(1));
+  }
+
+  // The producer does not wait for a non-gating reader, which gets lapped
+  // and then resumes with the next element pushed
+  {
+    BroadcastFifo<int> fifo(4, 2);
+    fifo.gating(1, false);
+    for (int i = 0; i < 4; ++i) {
+      CHECK(fifo.push(i));
+    }
+    CHECK(not fifo.push(4));
+    int value;
+    for (int i = 0; i < 4; ++i) {
+      CHECK(fifo.pop(0, value) and value == i);
+    }
+    for (int i = 4; i < 8; ++i) {
+      CHECK(fifo.push(i));
+    }
+    CHECK(fifo.size(1) == 8);
+    CHECK(not fifo.pop(1, value));
+    CHECK(fifo.lapped(1) == 1 and fifo.empty(1));
+    CHECK(fifo.pop(0, value) and value == 4);
+    CHECK(fifo.push(8));
+    CHECK(fifo.pop(1, value) and value == 8);
+    CHECK(fifo.lapped(0) == 0 and fifo.size(0) == 4);
+  }
+}
+
+static void smokePipelineRing() {
+  struct Entry {
+    std::uint64_t seq = 0;
+    std::uint64_t doubled = 0;
+    std::uint64_t squared = 0;
+  };
+
+  // Diamond: 1 and 2 follow 0, 3 follows both; single-threaded gating checks
+  {
+    PipelineRing<Entry> ring(4, {{}, {0}, {0}, {1, 2}});
+    CHECK(ring.stages() == 4 and ring.capacity() == 4);
+    for (std::uint64_t i = 0; i < 4; ++i) {
+      auto entry = ring.claim();
+      CHECK(entry);
+      entry->seq = i;
+      ring.publish();
+    }
+    CHECK(not ring.claim());
+    CHECK(ring.available(0) == 4 and ring.available(1) == 0);
+    CHECK(ring.front(0)->seq == 0 and ring.at(0, 3).seq == 3);
+    ring.release(0, 2);
+    CHECK(ring.available(1) == 2 and ring.available(2) == 2);
+    ring.release(1, 2);
+    CHECK(ring.available(3) == 0);
+    ring.release(2);
+    CHECK(ring.available(3) == 1 and ring.front(3)->seq == 0);
+    CHECK(not ring.push(Entry{}));
+    ring.release(3);
+    CHECK(ring.push(Entry{4}));
+    CHECK(not ring.push(Entry{5}));
+  }
+
+  // A chain with one thread per stage mutates each entry in place
+  {
+    PipelineRing<Entry> ring(8, {{}, {0}});
+    constexpr std::uint64_t count = 50'000;
+    auto doubler = std::thread([&] {
+      for (std::uint64_t done = 0; done < count;) {
+        auto n = ring.available(0);
+        if (n == 0) {
+          std::this_thread::yield();
+          continue;
+        }
+        for (std::uint64_t i = 0; i < n; ++i) {
+          auto& entry = ring.at(0, i);
+          entry.doubled = entry.seq * 2;
+        }
+        ring.release(0, n);
+        done += n;
+      }
+    });
+    auto squarer = std::thread([&] {
+      for (std::uint64_t next = 0; next < count;) {
+        auto entry = ring.front(1);
+        if (not entry) {
+          std::this_thread::yield();
+          continue;
+        }
+        CHECK(entry->seq == next and entry->doubled == next * 2);
+        entry->squared = entry->doubled * entry->doubled;
+        ring.release(1);
+        ++next;
+      }
+    });
+    for (std::uint64_t i = 0; i < count; ++i) {
+      Entry* entry;
+      while (not(entry = ring.claim())) {
+        std::this_thread::yield();
+      }
+      entry->seq = i;
+      ring.publish();
+    }
+    doubler.join();
+    squarer.join();
+    CHECK(ring.available(0) == 0 and ring.available(1) == 0);
+  }
+}
+
+static void smokeSegmentedFifo() {
+  // Growing past several segments, then recycling drained ones; the fifo is
+  // destroyed non-empty to run the destructor over live elements
+  {
+    SegmentedFifo<std::string, 4> fifo;
+    for (int i = 0; i < 10; ++i) {
+      CHECK(fifo.push(std::to_string(i)));
+    }
+    CHECK(fifo.size() == 10);
+    std::string value;
+    for (int i = 0; i < 7; ++i) {
+      CHECK(fifo.pop(value) and value == std::to_string(i));
+    }
+    for (int i = 10; i < 20; ++i) {
+      CHECK(fifo.emplace(std::to_string(i)));
+    }
+    for (int i = 7; i < 15; ++i) {
+      CHECK(fifo.pop(value) and value == std::to_string(i));
+    }
+    CHECK(fifo.size() == 5);
+  }
+
+  // Push never fails, however far the producer runs ahead
+  {
+    SegmentedFifo<std::uint64_t, 8> fifo;
+    constexpr std::uint64_t count = 100'000;
+    onTwoThreads(
+        [&] {
+          for (std::uint64_t i = 0; i < count; ++i) {
+            CHECK(fifo.push(i));
+          }
+        },
+        [&] {
+          for (std::uint64_t next = 0; next < count;) {
+            std::uint64_t value;
+            if (not fifo.pop(value)) {
+              std::this_thread::yield();
+              continue;
+            }
+            CHECK(value == next++);
+          }
+        });
+    CHECK(fifo.empty());
+  }
+}
+
+static void smokeFifo4() {
+  Fifo4<std::string> fifo(4);
+  std::string value;
+  CHECK(not fifo.pop(value));
+  for (int i = 0; i < 4; ++i) {
+    CHECK(fifo.push(std::to_string(i)));
+  }
+  CHECK(fifo.full() and not fifo.push("4"));
+  CHECK(fifo.pop(value) and value == "0");
+  CHECK(fifo.push("4") and fifo.size() == 4);
+
+  // The cached cursors are only refreshed at the full/empty edges, which a
+  // small ring hits constantly
+  Fifo4<std::uint64_t> stream(4);
+  constexpr std::uint64_t count = 100'000;
+  onTwoThreads(
+      [&] {
+        for (std::uint64_t i = 0; i < count; ++i) {
+          while (not stream.push(i)) {
+            std::this_thread::yield();
+          }
+        }
+      },
+      [&] {
+        for (std::uint64_t next = 0; next < count;) {
+          std::uint64_t value;
+          if (not stream.pop(value)) {
+            std::this_thread::yield();
+            continue;
+          }
+          CHECK(value == next++);
+        }
+      });
+  CHECK(stream.empty());
+}
+
+// `fifo` must hold ints, have a capacity of 8 and sample every 4th element
+template<typename Fifo>
+static void smokeTelemetry(Fifo& fifo) {
+  int value;
+  CHECK(not fifo.pop(value));
+  for (int i = 0; i < 8; ++i) {
+    CHECK(fifo.push(i));
+  }
+  CHECK(not fifo.push(8));
+  for (int i = 0; i < 8; ++i) {
+    CHECK(fifo.pop(value) and value == i);
+  }
+  auto stats = fifo.stats();
+  CHECK(stats.pushes == 8 and stats.pops == 8);
+  CHECK(stats.fullRejects == 1 and stats.emptyRejects == 1);
+  CHECK(stats.highWater == 8);
+  CHECK(stats.dwellSamples == 2);
+  CHECK(stats.dwellMaxTicks <= stats.dwellTotalTicks);
+  std::uint64_t histogramSamples = 0;
+  for (auto samples : stats.dwellHistogram) {
+    histogramSamples += samples;
+  }
+  CHECK(histogramSamples == stats.dwellSamples);
+}
+
+static void smokeConflatingQueue() {
+  struct Quote {
+    std::uint64_t seq;
+    std::uint64_t check;
+  };
+
+  // Repeated updates to one symbol collapse into a single pending entry
+  {
+    ConflatingQueue<Quote> queue(4);
+    CHECK(queue.symbols() == 4 and queue.pending() == 0);
+    for (std::uint64_t i = 1; i <= 3; ++i) {
+      queue.update(1, Quote{i, i});
+    }
+    queue.update(2, Quote{7, 7});
+    CHECK(queue.pending() == 2);
+    Quote latest[4]{};
+    auto visited = queue.drain([&](auto symbol, Quote const& quote) { latest[symbol] = quote; });
+    CHECK(visited == 2 and queue.pending() == 0);
+    CHECK(latest[1].seq == 3 and latest[2].seq == 7);
+    ConflatingQueue<Quote>::symbol_type symbol;
+    Quote quote;
+    CHECK(not queue.poll(symbol, quote));
+    queue.read(1, quote);
+    CHECK(quote.seq == 3);
+  }
+
+  // Across threads the consumer never sees a torn value or one older than
+  // it already saw, and always ends up with each symbol's final one
+  {
+    constexpr std::uint32_t symbols = 4;
+    constexpr std::uint64_t updates = 50'000;
+    ConflatingQueue<Quote> queue(symbols);
+    onTwoThreads(
+        [&] {
+          for (std::uint64_t i = 1; i <= updates; ++i) {
+            queue.update(i % symbols, Quote{i, i * 3});
+          }
+        },
+        [&] {
+          std::array<std::uint64_t, symbols> seen{};
+          auto done = [&] {
+            for (std::uint32_t s = 0; s < symbols; ++s) {
+              if (seen[s] <= updates - symbols) {
+                return false;
+              }
+            }
+            return true;
+          };
+          while (not done()) {
+            ConflatingQueue<Quote>::symbol_type symbol;
+            Quote quote;
+            if (not queue.poll(symbol, quote)) {
+              std::this_thread::yield();
+              continue;
+            }
+            CHECK(quote.check == quote.seq * 3 and quote.seq % symbols == symbol);
+            CHECK(quote.seq >= seen[symbol]);
+            seen[symbol] = quote.seq;
+          }
+        });
+  }
+}
+
+static void smokeByteRing() {
+  // A record of max_record_size() fits an empty ring at every start offset,
+  // including those where it has to skip the tail and wrap
+  {
+    ByteRing<> ring(64);
+    CHECK(ring.capacity() == 64);
+    auto maxSize = ring.max_record_size();
+    std::vector<std::byte> record(maxSize);
+    // The ring is empty, so an empty reservation starts at offset 0
+    auto base = ring.reserve(0) - 8;
+    for (std::size_t start = 0; start < ring.capacity(); start += 8) {
+      // Empty records move the cursors 8 bytes at a time
+      while (static_cast<std::size_t>(ring.reserve(0) - 8 - base) != start) {
+        ring.commit(0);
+        CHECK(ring.peek().data() and ring.peek().empty());
+        ring.release();
+      }
+      for (std::size_t i = 0; i < maxSize; ++i) {
+        record[i] = std::byte(start + i);
+      }
+      CHECK(ring.push(record.data(), maxSize));
+      auto span = ring.peek();
+      CHECK(span.data() and span.size() == maxSize);
+      CHECK(std::equal(span.begin(), span.end(), record.begin()));
+      ring.release();
+      CHECK(ring.empty() and not ring.peek().data());
+    }
+
+    // reserve() then commit() a shorter record
+    auto bytes = ring.reserve(20);
+    CHECK(bytes);
+    std::fill_n(bytes, 5, std::byte{0x5a});
+    ring.commit(5);
+    auto span = ring.peek();
+    CHECK(span.size() == 5 and span[4] == std::byte{0x5a});
+    ring.release();
+  }
+
+  // Variable-length records across threads arrive whole and in order
+  {
+    ByteRing<> ring(256);
+    constexpr std::size_t count = 50'000;
+    onTwoThreads(
+        [&] {
+          for (std::size_t i = 0; i < count; ++i) {
+            auto size = i % 50;
+            std::byte* bytes;
+            while (not(bytes = ring.reserve(size))) {
+              std::this_thread::yield();
+            }
+            for (std::size_t k = 0; k < size; ++k) {
+              bytes[k] = std::byte(i + k);
+            }
+            ring.commit(size);
+          }
+        },
+        [&] {
+          for (std::size_t i = 0; i < count;) {
+            auto span = ring.peek();
+            if (not span.data()) {
+              std::this_thread::yield();
+              continue;
+            }
+            CHECK(span.size() == i % 50);
+            for (std::size_t k = 0; k < span.size(); ++k) {
+              CHECK(span[k] == std::byte(i + k));
+            }
+            ring.release();
+            ++i;
+          }
+        });
+    CHECK(ring.empty());
+  }
+}
+
+static void smokeHugePageAllocator() {
+  // Runs with or without a hugetlb pool; the allocator falls back by itself
+  HugePageAllocator<int> alloc(HugePageOptions{.numaNode = 0, .prefault = true, .lock = false});
+  {
+    Fifo3<int, HugePageAllocator<int>> fifo(8, alloc);
+    smokeBulk(fifo);
+  }
+  {
+    // Rebinds to the fifo's segment type and keeps the options
+    SegmentedFifo<int, 1024, HugePageAllocator<int>> fifo(alloc);
+    for (int i = 0; i < 3000; ++i) {
+      CHECK(fifo.push(i));
+    }
+    int value;
+    for (int i = 0; i < 3000; ++i) {
+      CHECK(fifo.pop(value) and value == i);
+    }
+  }
+  HugePageAllocator<std::uint64_t> rebound(alloc);
+  CHECK(rebound.options().numaNode == 0);
+  // Any instance frees what another allocated, whatever its options
+  static_assert(std::allocator_traits<HugePageAllocator<int>>::is_always_equal::value);
+  CHECK(rebound == alloc and HugePageAllocator<int>{} == alloc);
+  CHECK(throws<std::system_error>([] {
+    HugePageAllocator<int>(HugePageOptions{.numaNode = 1 << 20}).allocate(1);
+  }));
+  auto p = rebound.allocate(3);
+  CHECK(reinterpret_cast<std::uintptr_t>(p) % 4096 == 0);
+  p[2] = 42;
+  rebound.deallocate(p, 3);
+}
+
+// Pops `count` values into `out`, then stops `scheduler` if asked to
+static Task collect(AsyncFifo<std::uint64_t>& fifo, std::vector<std::uint64_t>& out,
+                    std::size_t count, Scheduler* stopWhenDone) {
+  for (std::size_t i = 0; i < count; ++i) {
+    out.push_back(co_await fifo.pop());
+  }
+  if (stopWhenDone) {
+    stopWhenDone->stop();
+  }
+}
+
+static Task increment(int& counter) {
+  ++counter;
+  co_return;
+}
+
+static void smokeAsyncFifo() {
+  // The executor thread can post more than the ring holds without waiting
+  // for room only it could make
+  {
+    Scheduler scheduler(16);
+    int counter = 0;
+    for (int i = 0; i < 40; ++i) {
+      increment(counter).spawn(scheduler);
+    }
+    CHECK(scheduler.poll() == 40 and counter == 40);
+  }
+
+  // Driven by poll() on one thread: the consumer suspends on an empty fifo
+  // and a push posts it back
+  {
+    Scheduler scheduler(16);
+    AsyncFifo<std::uint64_t> fifo(4, scheduler);
+    std::vector<std::uint64_t> out;
+    collect(fifo, out, 3, nullptr).spawn(scheduler);
+    CHECK(out.empty());
+    CHECK(scheduler.poll() == 1 and out.empty());
+    CHECK(scheduler.poll() == 0);
+    CHECK(fifo.push(10) and fifo.push(11));
+    CHECK(scheduler.poll() == 1);
+    CHECK((out == std::vector<std::uint64_t>{10, 11}));
+    CHECK(fifo.push(12));
+    CHECK(scheduler.poll() == 1 and out.size() == 3 and out[2] == 12);
+    CHECK(fifo.push(13) and scheduler.poll() == 0 and fifo.size() == 1);
+  }
+
+  // A producer thread wakes a consumer coroutine polled on this one. run()
+  // never yields, which would starve the producer on a single core.
+  {
+    constexpr std::size_t count = 50'000;
+    Scheduler scheduler(16);
+    AsyncFifo<std::uint64_t> fifo(8, scheduler);
+    std::vector<std::uint64_t> out;
+    out.reserve(count);
+    collect(fifo, out, count, nullptr).spawn(scheduler);
+    onTwoThreads(
+        [&] {
+          for (std::uint64_t i = 0; i < count; ++i) {
+            while (not fifo.push(i)) {
+              std::this_thread::yield();
+            }
+          }
+        },
+        [&] {
+          while (out.size() < count) {
+            if (scheduler.poll() == 0) {
+              std::this_thread::yield();
+            }
+          }
+        });
+    for (std::size_t i = 0; i < count; ++i) {
+      CHECK(out[i] == i);
+    }
+  }
+
+  // run() returns once a coroutine calls stop()
+  {
+    Scheduler scheduler(16);
+    AsyncFifo<std::uint64_t> fifo(4, scheduler);
+    std::vector<std::uint64_t> out;
+    CHECK(fifo.push(5));
+    collect(fifo, out, 1, &scheduler).spawn(scheduler);
+    scheduler.run();
+    CHECK(out.size() == 1 and out[0] == 5);
+  }
+}
+
+int main() {
+  smokeFifo4();
+  {
+    Fifo3<int> fifo(8);
+    smokeBulk(fifo);
+  }
+  {
+    Fifo3<std::unique_ptr<std::string>> fifo(4);
+    smokeInPlace(fifo);
+  }
+  {
+    auto fifo = std::make_unique<FixedFifo3<int, 8>>();
+    smokeBulk(*fifo);
+  }
+  {
+    auto fifo = std::make_unique<FixedFifo3<std::unique_ptr<std::string>, 4>>();
+    smokeInPlace(*fifo);
+  }
+  smokeBlockingFifo3();
+  smokeMpmcFifo();
+  smokeMpscFifo();
+  smokeBroadcastFifo();
+  smokePipelineRing();
+  smokeSegmentedFifo();
+  {
+    Fifo3<int, std::allocator<int>, QueueTelemetry<4>> fifo(8);
+    smokeTelemetry(fifo);
+    // A batch counts as one push per element
+    std::array<int, 3> batch{};
+    CHECK(fifo.push_n(batch.begin(), 3) == 3);
+    CHECK(fifo.pop_n(batch.begin(), 3) == 3);
+    CHECK(fifo.stats().pushes == 11 and fifo.stats().pops == 11);
+  }
+  {
+    // A batch spanning several sampled cursors stamps every one of them.
+    // The fifo is fresh, so a missed stamp reads as 0 and the dwell as the
+    // whole uptime.
+    Fifo3<int, std::allocator<int>, QueueTelemetry<4>> fifo(16);
+    std::array<int, 12> batch{};
+    CHECK(fifo.push_n(batch.begin(), 12) == 12);
+    int value;
+    for (int i = 0; i < 6; ++i) {
+      CHECK(fifo.pop(value));
+    }
+    CHECK(fifo.pop_n(batch.begin(), 6) == 6);
+    auto stats = fifo.stats();
+    CHECK(stats.dwellSamples == 3);
+    CHECK(stats.dwellMaxTicks < std::uint64_t{1} << 36);
+  }
+  {
+    Fifo4<int, std::allocator<int>, QueueTelemetry<4>> fifo(8);
+    smokeTelemetry(fifo);
+  }
+  CHECK(Fifo3<int>(8).stats().pushes == 0);
+  smokeConflatingQueue();
+  smokeByteRing();
+  smokeHugePageAllocator();
+  smokeAsyncFifo();
+  std::puts("smoke_spsc: ok");
+}
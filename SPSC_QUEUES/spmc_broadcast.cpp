@@ -0,0 +1,176 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+
+/// Threadsafe circular FIFO with one producer and several broadcast readers
+///
+/// Every reader owns a cursor and sees every element, so one ring replaces N
+/// Fifo3 instances carrying the same data. The producer only waits for the
+/// slowest *gating* reader. A non-gating reader that falls more than a lap
+/// behind is detected after its copy and counted in lapped(); everything
+/// already published is skipped and the reader resumes with the next element
+/// the producer pushes. Elements are overwritten in place, hence the
+/// trivially copyable requirement.
+template<typename T, typename Alloc = std::allocator<T>>
+class BroadcastFifo : private Alloc
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+
+public:
+    using value_type = T;
+    using allocator_traits = std::allocator_traits<Alloc>;
+    using size_type = typename allocator_traits::size_type;
+
+    /// Creates a ring whose `readers` readers all gate the producer
+    BroadcastFifo(size_type capacity, size_type readers, Alloc const& alloc = Alloc{})
+        : Alloc{alloc}
+        , capacity_{capacity}
+        , ring_{allocator_traits::allocate(*this, capacity)}
+        , readerCount_{readers}
+        , readers_{std::make_unique<Reader[]>(readers)}
+    {}
+
+    BroadcastFifo(BroadcastFifo const&) = delete;
+    BroadcastFifo& operator=(BroadcastFifo const&) = delete;
+    BroadcastFifo(BroadcastFifo&&) = delete;
+    BroadcastFifo& operator=(BroadcastFifo&&) = delete;
+
+    ~BroadcastFifo() {
+        allocator_traits::deallocate(*this, ring_, capacity_);
+    }
+
+
+    /// Returns the number of elements `reader` has not consumed yet
+    auto size(size_type reader) const noexcept {
+        auto pushCursor = pushCursor_.load(std::memory_order_relaxed);
+        auto readCursor = readers_[reader].cursor.load(std::memory_order_relaxed);
+        return pushCursor - readCursor;
+    }
+
+    /// Returns whether `reader` has consumed every element
+    auto empty(size_type reader) const noexcept { return size(reader) == 0; }
+
+    /// Returns the number of elements that can be held in the fifo
+    auto capacity() const noexcept { return capacity_; }
+
+    /// Returns the number of readers
+    auto readers() const noexcept { return readerCount_; }
+
+    /// Selects whether the producer waits for `reader`.
+    /// Must be called before the fifo is in use.
+    void gating(size_type reader, bool gates) noexcept {
+        readers_[reader].gating = gates;
+    }
+
+    /// Returns how many times `reader` was lapped and skipped ahead
+    auto lapped(size_type reader) const noexcept {
+        return readers_[reader].lapped.load(std::memory_order_relaxed);
+    }
+
+
+    /// Push one object onto the fifo.
+    /// @return `true` if the operation is successful; `false` if the slowest
+    /// gating reader has not consumed the slot about to be overwritten.
+    auto push(T const& value) {
+        auto pushCursor = pushCursor_.load(std::memory_order_relaxed);
+        if (pushCursor - gatingCursorCached_ == capacity_) {
+            gatingCursorCached_ = slowestGatingCursor(pushCursor);
+            if (pushCursor - gatingCursorCached_ == capacity_) {
+                return false;
+            }
+        }
+        // Keeps the overwrite below from becoming visible before the
+        // previous cursor publish; non-gating readers rely on that order.
+        std::atomic_thread_fence(std::memory_order_release);
+        new (element(pushCursor)) T(value);
+        pushCursor_.store(pushCursor + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// Pop one object from the fifo on behalf of `reader`.
+    /// @return `true` if the pop operation is successful; `false` if `reader`
+    /// has consumed every element or was lapped. A lapped reader skips to the
+    /// push cursor, so its next successful pop returns the next element pushed.
+    auto pop(size_type reader, T& value) {
+        auto& r = readers_[reader];
+        auto readCursor = r.cursor.load(std::memory_order_relaxed);
+        if (r.pushCursorCached == readCursor) {
+            r.pushCursorCached = pushCursor_.load(std::memory_order_acquire);
+            if (r.pushCursorCached == readCursor) {
+                return false;
+            }
+        }
+        value = *element(readCursor);
+        if (not r.gating) {
+            // The producer starts overwriting this slot once it has published
+            // cursor readCursor + capacity_.
+            std::atomic_thread_fence(std::memory_order_acquire);
+            auto pushCursor = pushCursor_.load(std::memory_order_relaxed);
+            if (pushCursor - readCursor >= capacity_) {
+                r.lapped.store(r.lapped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                r.pushCursorCached = pushCursor;
+                r.cursor.store(pushCursor, std::memory_order_relaxed);
+                return false;
+            }
+        }
+        r.cursor.store(readCursor + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    auto slowestGatingCursor(size_type pushCursor) const noexcept {
+        auto slowest = pushCursor;
+        for (size_type i = 0; i < readerCount_; ++i) {
+            if (readers_[i].gating) {
+                auto readCursor = readers_[i].cursor.load(std::memory_order_acquire);
+                if (pushCursor - readCursor > pushCursor - slowest) {
+                    slowest = readCursor;
+                }
+            }
+        }
+        return slowest;
+    }
+    auto element(size_type cursor) noexcept {
+        return &ring_[cursor % capacity_];
+    }
+
+private:
+    size_type capacity_;
+    T* ring_;
+
+    using CursorType = std::atomic<size_type>;
+    static_assert(CursorType::is_always_lock_free);
+
+    // See Fifo3 for why std::hardware_destructive_interference_size is not used
+    static constexpr auto hardware_destructive_interference_size = size_type{64};
+
+    struct alignas(hardware_destructive_interference_size) Reader
+    {
+        /// Loaded and stored by this reader; loaded by the push thread
+        CursorType cursor{};
+        /// Exclusive to this reader
+        size_type pushCursorCached{};
+        /// Stored by this reader; loaded by monitoring threads
+        CursorType lapped{};
+        /// Fixed before the fifo is in use
+        bool gating = true;
+    };
+
+    size_type readerCount_;
+    std::unique_ptr<Reader[]> readers_;
+
+    /// Loaded and stored by the push thread; loaded by the readers
+    alignas(hardware_destructive_interference_size) CursorType pushCursor_{};
+
+    /// Exclusive to the push thread
+    size_type gatingCursorCached_{};
+
+    // Padding to avoid false sharing with adjacent objects
+    char padding_[hardware_destructive_interference_size - 2 * sizeof(size_type)];
+};
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <span>
+
+
+/// Threadsafe circular byte FIFO of variable-length records
+///
+/// Records are stored contiguously behind an 8-byte length header and padded
+/// to 8 bytes, so a 24-byte quote and a 200-byte order event share one ring
+/// without padding either to the largest type. A record never wraps: when it
+/// does not fit before the end of the ring the producer writes a skip marker
+/// and starts it at offset 0. Both sides work in place through
+/// reserve()/commit() and peek()/release(); cursors are cached as in Fifo4.
+template<typename Alloc = std::allocator<std::byte>>
+class ByteRing : private Alloc
+{
+public:
+    using allocator_traits = std::allocator_traits<Alloc>;
+    using size_type = typename allocator_traits::size_type;
+
+    /// `capacity` is rounded up to a power of two of at least 64 bytes
+    explicit ByteRing(size_type capacity, Alloc const& alloc = Alloc{})
+        : Alloc{alloc}
+        , capacity_{std::bit_ceil(capacity < 64 ? size_type{64} : capacity)}
+        , ring_{allocator_traits::allocate(*this, capacity_)}
+    {}
+
+    ByteRing(ByteRing const&) = delete;
+    ByteRing& operator=(ByteRing const&) = delete;
+    ByteRing(ByteRing&&) = delete;
+    ByteRing& operator=(ByteRing&&) = delete;
+
+    ~ByteRing() {
+        allocator_traits::deallocate(*this, ring_, capacity_);
+    }
+
+
+    /// Returns the number of bytes in use, including headers and padding
+    auto size() const noexcept {
+        auto pushCursor = pushCursor_.load(std::memory_order_relaxed);
+        auto popCursor = popCursor_.load(std::memory_order_relaxed);
+
+        assert(popCursor <= pushCursor);
+        return pushCursor - popCursor;
+    }
+
+    /// Returns whether the container has no records
+    auto empty() const noexcept { return size() == 0; }
+
+    /// Returns the number of bytes that can be held in the ring
+    auto capacity() const noexcept { return capacity_; }
+
+    /// Returns the largest record that reserve() accepts. A record that
+    /// would straddle the end of the ring also costs the skipped tail, so
+    /// only half the ring is guaranteed to fit even when it is empty.
+    auto max_record_size() const noexcept { return capacity_ / 2 - sizeof(Header); }
+
+
+    /// Reserve room for a record of up to `size` bytes without publishing it.
+    /// @return pointer to the record's bytes; `nullptr` if the ring is full.
+    std::byte* reserve(size_type size) noexcept {
+        assert(size <= max_record_size());
+        auto pushCursor = pushCursor_.load(std::memory_order_relaxed);
+        auto offset = pushCursor & (capacity_ - 1);
+        auto footprint = recordFootprint(size);
+        auto tail = capacity_ - offset;
+        auto needed = tail < footprint ? tail + footprint : footprint;
+        if (needed > capacity_ - (pushCursor - popCursorCached_)) {
+            popCursorCached_ = popCursor_.load(std::memory_order_acquire);
+            if (needed > capacity_ - (pushCursor - popCursorCached_)) {
+                return nullptr;
+            }
+        }
+        if (tail < footprint) {
+            header(offset)->size = skipMarker;
+            pushCursor += tail;
+            offset = 0;
+        }
+        reservedCursor_ = pushCursor;
+        return ring_ + offset + sizeof(Header);
+    }
+
+    /// Publish the record returned by the last reserve(), trimmed to `size`
+    /// bytes; `size` must not exceed the reserved size.
+    void commit(size_type size) noexcept {
+        header(reservedCursor_ & (capacity_ - 1))->size = static_cast<std::uint32_t>(size);
+        pushCursor_.store(reservedCursor_ + recordFootprint(size), std::memory_order_release);
+    }
+
+    /// Copy one record of `size` bytes into the ring.
+    /// @return `true` if the operation is successful; `false` if the ring is full.
+    auto push(void const* data, size_type size) noexcept {
+        auto record = reserve(size);
+        if (not record) {
+            return false;
+        }
+        std::memcpy(record, data, size);
+        commit(size);
+        return true;
+    }
+
+    /// Access the oldest record in place; it stays in the ring until
+    /// release() is called.
+    /// @return the record's bytes; a span with a null data() if the ring is
+    /// empty (an empty record has a non-null data()).
+    std::span<std::byte> peek() noexcept {
+        auto popCursor = popCursor_.load(std::memory_order_relaxed);
+        if (popCursor == pushCursorCached_) {
+            pushCursorCached_ = pushCursor_.load(std::memory_order_acquire);
+            if (popCursor == pushCursorCached_) {
+                return {};
+            }
+        }
+        auto offset = popCursor & (capacity_ - 1);
+        if (header(offset)->size == skipMarker) {
+            // The producer always commits a record after a skip marker
+            popCursor += capacity_ - offset;
+            offset = 0;
+        }
+        auto size = header(offset)->size;
+        frontCursor_ = popCursor + recordFootprint(size);
+        return {ring_ + offset + sizeof(Header), size};
+    }
+
+    /// Hand the record returned by the last peek() back to the producer.
+    void release() noexcept {
+        popCursor_.store(frontCursor_, std::memory_order_release);
+    }
+
+private:
+    struct Header
+    {
+        std::uint32_t size;
+        std::uint32_t reserved;
+    };
+    static_assert(sizeof(Header) == 8);
+
+    static constexpr auto skipMarker = ~std::uint32_t{0};
+
+    static auto recordFootprint(size_type size) noexcept {
+        return (sizeof(Header) + size + 7) & ~size_type{7};
+    }
+    auto header(size_type offset) noexcept {
+        return reinterpret_cast<Header*>(ring_ + offset);
+    }
+
+private:
+    size_type capacity_;
+    std::byte* ring_;
+
+    using CursorType = std::atomic<size_type>;
+    static_assert(CursorType::is_always_lock_free);
+
+    // See Fifo3 for why std::hardware_destructive_interference_size is not used
+    static constexpr auto hardware_destructive_interference_size = size_type{64};
+
+    /// Loaded and stored by the push thread; loaded by the pop thread
+    alignas(hardware_destructive_interference_size) CursorType pushCursor_{};
+
+    /// Exclusive to the push thread
+    size_type popCursorCached_{};
+    size_type reservedCursor_{};
+
+    /// Loaded and stored by the pop thread; loaded by the push thread
+    alignas(hardware_destructive_interference_size) CursorType popCursor_{};
+
+    /// Exclusive to the pop thread
+    size_type pushCursorCached_{};
+    size_type frontCursor_{};
+
+    // Padding to avoid false sharing with adjacent objects
+    char padding_[hardware_destructive_interference_size - 3 * sizeof(size_type)];
+};
@@ -0,0 +1,236 @@
+#pragma once
+
+#include "mpsc_q.cpp"
+#include "spsc_q4.cpp"
+
+#include <atomic>
+#include <cassert>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+
+/// Single-threaded executor for coroutines
+///
+/// Runs every coroutine handle posted to it on the thread that calls run()
+/// or poll(). post() may be called from any thread, so a producer on another
+/// core can hand a consumer coroutine back to the executor that owns it.
+/// Posts from the executor thread itself (the one that constructed the
+/// scheduler or last polled it) go to an unbounded local list instead of the
+/// ring: nothing else drains the ring, so waiting for room there would
+/// never end.
+class Scheduler
+{
+public:
+    explicit Scheduler(std::size_t capacity = 4096)
+        : ready_{capacity}
+        , executor_{std::this_thread::get_id()}
+    {}
+
+    /// Queue `handle` to be resumed on the executor thread; any thread.
+    /// Other threads wait while the ring is full.
+    void post(std::coroutine_handle<> handle) {
+        if (std::this_thread::get_id() == executor_.load(std::memory_order_relaxed)) {
+            local_.push_back(handle);
+            return;
+        }
+        while (not ready_.push(handle)) {
+            std::this_thread::yield();
+        }
+    }
+
+    /// Resume the coroutines that are ready now.
+    /// @return the number of coroutines resumed.
+    std::size_t poll() {
+        executor_.store(std::this_thread::get_id(), std::memory_order_relaxed);
+        std::size_t resumed = 0;
+        std::coroutine_handle<> handle;
+        for (auto pending = ready_.size(); resumed < pending and ready_.pop(handle); ++resumed) {
+            handle.resume();
+        }
+        if (not local_.empty()) {
+            // Coroutines resumed here may post again; those wait for the
+            // next poll()
+            auto local = std::exchange(local_, {});
+            for (auto localHandle : local) {
+                localHandle.resume();
+            }
+            resumed += local.size();
+        }
+        return resumed;
+    }
+
+    /// Resume coroutines as they become ready until stop() is called.
+    void run() {
+        while (not stopped_.load(std::memory_order_relaxed)) {
+            if (poll() == 0) {
+#if defined(__x86_64__) || defined(__i386__)
+                __builtin_ia32_pause();
+#endif
+            }
+        }
+    }
+
+    /// Make run() return; any thread.
+    void stop() noexcept {
+        stopped_.store(true, std::memory_order_relaxed);
+    }
+
+private:
+    MpscFifo<std::coroutine_handle<>> ready_;
+    std::atomic<bool> stopped_{false};
+    /// Loaded by every post(); stored by poll()
+    std::atomic<std::thread::id> executor_;
+    /// Exclusive to the executor thread
+    std::vector<std::coroutine_handle<>> local_;
+};
+
+
+/// Fire-and-forget coroutine started on a Scheduler
+///
+/// The coroutine does not run until spawn() posts it and frees itself when
+/// it finishes. Coroutines still suspended when their Scheduler goes away
+/// are leaked.
+class Task
+{
+public:
+    struct promise_type
+    {
+        Task get_return_object() noexcept {
+            return Task{std::coroutine_handle<promise_type>::from_promise(*this)};
+        }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept { std::terminate(); }
+    };
+
+    Task(Task&& other) noexcept
+        : handle_{std::exchange(other.handle_, {})}
+    {}
+    Task(Task const&) = delete;
+    Task& operator=(Task const&) = delete;
+    Task& operator=(Task&&) = delete;
+
+    ~Task() {
+        if (handle_) {
+            handle_.destroy();
+        }
+    }
+
+    /// Hand the coroutine to `scheduler`, which runs it from then on.
+    void spawn(Scheduler& scheduler) && {
+        scheduler.post(std::exchange(handle_, {}));
+    }
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> handle) noexcept
+        : handle_{handle}
+    {}
+
+    std::coroutine_handle<promise_type> handle_;
+};
+
+
+/// Fifo4 whose consumer is a coroutine: `co_await fifo.pop()`
+///
+/// When the fifo is empty the consumer coroutine suspends instead of
+/// polling, and the next push posts it back onto the consumer's Scheduler.
+/// push() may be called from any one producer thread; it pays one fence to
+/// check for a suspended consumer and posts only when there is one.
+template<typename T, typename Alloc = std::allocator<T>>
+class AsyncFifo
+{
+public:
+    using value_type = T;
+    using size_type = typename Fifo4<T, Alloc>::size_type;
+
+    AsyncFifo(size_type capacity, Scheduler& consumer, Alloc const& alloc = Alloc{})
+        : fifo_{capacity, alloc}
+        , consumer_{consumer}
+    {}
+
+
+    /// Returns the number of elements in the fifo
+    auto size() const noexcept { return fifo_.size(); }
+
+    /// Returns whether the container has no elements
+    auto empty() const noexcept { return fifo_.empty(); }
+
+    /// Returns the number of elements that can be held in the fifo
+    auto capacity() const noexcept { return fifo_.capacity(); }
+
+
+    /// Push one object onto the fifo and wake the consumer if it is waiting.
+    /// @return `true` if the operation is successful; `false` if fifo is full.
+    auto push(T const& value) {
+        if (not fifo_.push(value)) {
+            return false;
+        }
+        // Pairs with the fence in PopAwaiter::await_suspend()
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiter_.load(std::memory_order_relaxed)) {
+            if (auto address = waiter_.exchange(nullptr, std::memory_order_acquire)) {
+                consumer_.post(std::coroutine_handle<>::from_address(address));
+            }
+        }
+        return true;
+    }
+
+    class PopAwaiter
+    {
+    public:
+        explicit PopAwaiter(AsyncFifo& fifo) noexcept
+            : fifo_{fifo}
+        {}
+
+        bool await_ready() {
+            popped_ = fifo_.fifo_.pop(value_);
+            return popped_;
+        }
+
+        bool await_suspend(std::coroutine_handle<> handle) {
+            fifo_.waiter_.store(handle.address(), std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (fifo_.fifo_.empty()) {
+                return true;
+            }
+            // A push slipped in; take the handle back unless that push
+            // already posted it.
+            return fifo_.waiter_.exchange(nullptr, std::memory_order_acquire) != handle.address();
+        }
+
+        T await_resume() {
+            if (not popped_) {
+                // Resumed because the fifo is no longer empty
+                [[maybe_unused]] auto popped = fifo_.fifo_.pop(value_);
+                assert(popped);
+            }
+            return std::move(value_);
+        }
+
+    private:
+        AsyncFifo& fifo_;
+        T value_{};
+        bool popped_ = false;
+    };
+
+    /// Pop one object; suspends the calling coroutine while fifo is empty.
+    PopAwaiter pop() noexcept {
+        return PopAwaiter{*this};
+    }
+
+private:
+    Fifo4<T, Alloc> fifo_;
+    Scheduler& consumer_;
+
+    // See Fifo3 for why std::hardware_destructive_interference_size is not used
+    static constexpr auto hardware_destructive_interference_size = std::size_t{64};
+
+    /// Stored by the consumer before it suspends; taken by whoever resumes it
+    alignas(hardware_destructive_interference_size) std::atomic<void*> waiter_{nullptr};
+};
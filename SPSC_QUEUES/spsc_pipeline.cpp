@@ -0,0 +1,197 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+
+/// Threadsafe ring shared by one producer and a graph of consumer stages
+///
+/// Each stage is run by one thread and owns a cursor. A stage may only touch
+/// an entry once every stage it depends on has released it (a stage without
+/// dependencies follows the producer), and the producer only reuses an entry
+/// once every stage has released it. Entries are constructed up front and
+/// mutated in place, so decode -> risk -> journal runs on one set of slots
+/// without copies between stages.
+template<typename T, typename Alloc = std::allocator<T>>
+class PipelineRing : private Alloc
+{
+public:
+    using value_type = T;
+    using allocator_traits = std::allocator_traits<Alloc>;
+    using size_type = typename allocator_traits::size_type;
+
+    /// `dependencies[i]` lists the stages stage `i` waits for; every entry
+    /// must name an earlier stage so the graph is acyclic by construction.
+    PipelineRing(size_type capacity, std::vector<std::vector<size_type>> dependencies, Alloc const& alloc = Alloc{})
+        : Alloc{alloc}
+        , capacity_{capacity}
+        , ring_{allocator_traits::allocate(*this, capacity)}
+        , stageCount_{dependencies.size()}
+        , stages_{std::make_unique<Stage[]>(stageCount_)}
+    {
+        for (size_type i = 0; i < capacity_; ++i) {
+            allocator_traits::construct(*this, &ring_[i]);
+        }
+        std::vector<bool> hasDependents(stageCount_);
+        for (size_type i = 0; i < stageCount_; ++i) {
+            for (auto dependency : dependencies[i]) {
+                assert(dependency < i);
+                hasDependents[dependency] = true;
+            }
+            stages_[i].dependencies = std::move(dependencies[i]);
+        }
+        for (size_type i = 0; i < stageCount_; ++i) {
+            if (not hasDependents[i]) {
+                leaves_.push_back(i);
+            }
+        }
+    }
+
+    PipelineRing(PipelineRing const&) = delete;
+    PipelineRing& operator=(PipelineRing const&) = delete;
+    PipelineRing(PipelineRing&&) = delete;
+    PipelineRing& operator=(PipelineRing&&) = delete;
+
+    ~PipelineRing() {
+        for (size_type i = 0; i < capacity_; ++i) {
+            allocator_traits::destroy(*this, &ring_[i]);
+        }
+        allocator_traits::deallocate(*this, ring_, capacity_);
+    }
+
+
+    /// Returns the number of entries that can be held in the ring
+    auto capacity() const noexcept { return capacity_; }
+
+    /// Returns the number of stages
+    auto stages() const noexcept { return stageCount_; }
+
+
+    /// Access the next free entry without publishing it.
+    /// The entry still holds whatever the stages left in it.
+    /// @return pointer to the entry; `nullptr` if the ring is full.
+    T* claim() noexcept {
+        auto pushCursor = pushCursor_.load(std::memory_order_relaxed);
+        if (pushCursor - slowestCached_ == capacity_) {
+            slowestCached_ = slowestLeaf(pushCursor);
+            if (pushCursor - slowestCached_ == capacity_) {
+                return nullptr;
+            }
+        }
+        return element(pushCursor);
+    }
+
+    /// Hand the entry returned by claim() to the stages.
+    void publish() noexcept {
+        auto pushCursor = pushCursor_.load(std::memory_order_relaxed);
+        pushCursor_.store(pushCursor + 1, std::memory_order_release);
+    }
+
+    /// Copy one object into the ring and publish it.
+    /// @return `true` if the operation is successful; `false` if the ring is full.
+    auto push(T const& value) {
+        auto entry = claim();
+        if (not entry) {
+            return false;
+        }
+        *entry = value;
+        publish();
+        return true;
+    }
+
+
+    /// Returns the number of entries `stage` may process now
+    size_type available(size_type stage) noexcept {
+        auto& s = stages_[stage];
+        auto cursor = s.cursor.load(std::memory_order_relaxed);
+        if (s.barrierCached == cursor) {
+            s.barrierCached = barrier(s);
+        }
+        return s.barrierCached - cursor;
+    }
+
+    /// Access the `i`-th entry `stage` may process; `i < available(stage)`
+    T& at(size_type stage, size_type i) noexcept {
+        return *element(stages_[stage].cursor.load(std::memory_order_relaxed) + i);
+    }
+
+    /// Access the next entry `stage` may process in place.
+    /// @return pointer to the entry; `nullptr` if none is ready.
+    T* front(size_type stage) noexcept {
+        return available(stage) ? &at(stage, 0) : nullptr;
+    }
+
+    /// Pass the next `n` entries on to the dependent stages.
+    void release(size_type stage, size_type n = 1) noexcept {
+        auto& cursor = stages_[stage].cursor;
+        cursor.store(cursor.load(std::memory_order_relaxed) + n, std::memory_order_release);
+    }
+
+private:
+    using CursorType = std::atomic<size_type>;
+    static_assert(CursorType::is_always_lock_free);
+
+    // See Fifo3 for why std::hardware_destructive_interference_size is not used
+    static constexpr auto hardware_destructive_interference_size = size_type{64};
+
+    struct alignas(hardware_destructive_interference_size) Stage
+    {
+        /// Loaded and stored by this stage; loaded by dependents and the producer
+        CursorType cursor{};
+        /// Exclusive to this stage
+        size_type barrierCached{};
+        /// Fixed at construction
+        std::vector<size_type> dependencies;
+    };
+
+    /// Furthest cursor `s` may advance to: the slowest of its dependencies
+    size_type barrier(Stage const& s) const noexcept {
+        if (s.dependencies.empty()) {
+            return pushCursor_.load(std::memory_order_acquire);
+        }
+        auto slowest = stages_[s.dependencies.front()].cursor.load(std::memory_order_acquire);
+        for (auto dependency : s.dependencies) {
+            auto cursor = stages_[dependency].cursor.load(std::memory_order_acquire);
+            if (cursor < slowest) {
+                slowest = cursor;
+            }
+        }
+        return slowest;
+    }
+
+    /// Slowest final stage; every other stage is at least as far along
+    size_type slowestLeaf(size_type pushCursor) const noexcept {
+        auto slowest = pushCursor;
+        for (auto leaf : leaves_) {
+            auto cursor = stages_[leaf].cursor.load(std::memory_order_acquire);
+            if (cursor < slowest) {
+                slowest = cursor;
+            }
+        }
+        return slowest;
+    }
+
+    auto element(size_type cursor) noexcept {
+        return &ring_[cursor % capacity_];
+    }
+
+private:
+    size_type capacity_;
+    T* ring_;
+    size_type stageCount_;
+    std::unique_ptr<Stage[]> stages_;
+    std::vector<size_type> leaves_;
+
+    /// Loaded and stored by the push thread; loaded by the first stages
+    alignas(hardware_destructive_interference_size) CursorType pushCursor_{};
+
+    /// Exclusive to the push thread
+    size_type slowestCached_{};
+
+    // Padding to avoid false sharing with adjacent objects
+    char padding_[hardware_destructive_interference_size - 2 * sizeof(size_type)];
+};
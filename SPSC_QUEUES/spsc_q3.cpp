@@ -1,13 +1,21 @@
 #pragma once
 
+#include <algorithm>
 #include <atomic>
 #include <cassert>
+#include <iterator>
 #include <memory>
 #include <new>
+#include <utility>
+
+#include "spsc_telemetry.cpp"
 
 
 /// Threadsafe, efficient circular FIFO
-template<typename T, typename Alloc = std::allocator<T>>
+///
+/// `Telemetry` is a compile-time instrumentation policy; the default
+/// NoTelemetry adds nothing to the fast path. See QueueTelemetry.
+template<typename T, typename Alloc = std::allocator<T>, typename Telemetry = NoTelemetry>
 class Fifo3 : private Alloc
 {
 public:
@@ -19,6 +27,7 @@ public:
         : Alloc{alloc}
         , capacity_{capacity}
         , ring_{allocator_traits::allocate(*this, capacity)}
+        , telemetry_{capacity}
     {}
 
     ~Fifo3() {
@@ -48,18 +57,55 @@ public:
     /// Returns the number of elements that can be held in the fifo
     auto capacity() const noexcept { return capacity_; }
 
+    /// Returns a snapshot of the telemetry counters; callable from any thread
+    auto stats() const noexcept { return telemetry_.snapshot(); }
+
 
     /// Push one object onto the fifo.
     /// @return `true` if the operation is successful; `false` if fifo is full.
     auto push(T const& value) {
+        return emplace(value);
+    }
+
+    /// Push one object onto the fifo, moving from `value`.
+    /// @return `true` if the operation is successful; `false` if fifo is full.
+    auto push(T&& value) {
+        return emplace(std::move(value));
+    }
+
+    /// Construct one object in place at the back of the fifo.
+    /// @return `true` if the operation is successful; `false` if fifo is full.
+    template<typename... Args>
+    auto emplace(Args&&... args) {
+        auto slot = reserve();
+        if (not slot) {
+            return false;
+        }
+        new (slot) T(std::forward<Args>(args)...);
+        commit();
+        return true;
+    }
+
+    /// Reserve the slot at the back of the fifo without publishing it.
+    /// The caller constructs a T in the returned storage and then calls
+    /// commit(); no other push may happen in between.
+    /// @return uninitialized storage for one T; `nullptr` if fifo is full.
+    void* reserve() noexcept {
         auto pushCursor = pushCursor_.load(std::memory_order_relaxed);
         auto popCursor = popCursor_.load(std::memory_order_acquire);
         if (full(pushCursor, popCursor)) {
-            return false;
+            telemetry_.full();
+            return nullptr;
         }
-        new (element(pushCursor)) T(value);
+        telemetry_.occupancy(pushCursor - popCursor + 1);
+        return element(pushCursor);
+    }
+
+    /// Publish the object constructed in the slot returned by reserve().
+    void commit() noexcept {
+        auto pushCursor = pushCursor_.load(std::memory_order_relaxed);
+        telemetry_.pushed(pushCursor);
         pushCursor_.store(pushCursor + 1, std::memory_order_release);
-        return true;
     }
 
     /// Pop one object from the fifo.
@@ -68,14 +114,86 @@ public:
         auto pushCursor = pushCursor_.load(std::memory_order_acquire);
         auto popCursor = popCursor_.load(std::memory_order_relaxed);
         if (empty(pushCursor, popCursor)) {
+            telemetry_.empty();
             return false;
         }
-        value = *element(popCursor);
+        value = std::move(*element(popCursor));
         element(popCursor)->~T();
+        telemetry_.popped(popCursor);
         popCursor_.store(popCursor + 1, std::memory_order_release);
         return true;
     }
 
+    /// Access the object at the front of the fifo in place.
+    /// The object stays in the ring until release() is called.
+    /// @return pointer to the front object; `nullptr` if fifo is empty.
+    T* front() noexcept {
+        auto pushCursor = pushCursor_.load(std::memory_order_acquire);
+        auto popCursor = popCursor_.load(std::memory_order_relaxed);
+        if (empty(pushCursor, popCursor)) {
+            telemetry_.empty();
+            return nullptr;
+        }
+        return element(popCursor);
+    }
+
+    /// Destroy the front object and hand its slot back to the producer.
+    /// Must only be called after front() returned a non-null pointer.
+    void release() noexcept {
+        auto popCursor = popCursor_.load(std::memory_order_relaxed);
+        element(popCursor)->~T();
+        telemetry_.popped(popCursor);
+        popCursor_.store(popCursor + 1, std::memory_order_release);
+    }
+
+    /// Push up to `count` objects read from `first` onto the fifo.
+    /// Copies as many objects as fit, in at most two contiguous chunks, and
+    /// publishes the push cursor once for the whole batch.
+    /// @return the number of objects pushed; `0` if fifo is full.
+    template<std::input_iterator InputIt>
+    auto push_n(InputIt first, size_type count) {
+        auto pushCursor = pushCursor_.load(std::memory_order_relaxed);
+        auto popCursor = popCursor_.load(std::memory_order_acquire);
+        auto n = std::min(count, capacity_ - (pushCursor - popCursor));
+        if (n == 0) {
+            telemetry_.full();
+            return n;
+        }
+        telemetry_.occupancy(pushCursor - popCursor + n);
+        auto offset = pushCursor % capacity_;
+        auto chunk = std::min(n, capacity_ - offset);
+        first = std::ranges::uninitialized_copy_n(
+            first, chunk, ring_ + offset, ring_ + offset + chunk).in;
+        std::ranges::uninitialized_copy_n(first, n - chunk, ring_, ring_ + (n - chunk));
+        telemetry_.pushed(pushCursor, n);
+        pushCursor_.store(pushCursor + n, std::memory_order_release);
+        return n;
+    }
+
+    /// Pop up to `count` objects from the fifo into `out`.
+    /// Moves as many objects as are available, in at most two contiguous
+    /// chunks, and publishes the pop cursor once for the whole batch.
+    /// @return the number of objects popped; `0` if fifo is empty.
+    template<typename OutputIt>
+    auto pop_n(OutputIt out, size_type count) {
+        auto pushCursor = pushCursor_.load(std::memory_order_acquire);
+        auto popCursor = popCursor_.load(std::memory_order_relaxed);
+        auto n = std::min(count, pushCursor - popCursor);
+        if (n == 0) {
+            telemetry_.empty();
+            return n;
+        }
+        auto offset = popCursor % capacity_;
+        auto chunk = std::min(n, capacity_ - offset);
+        out = std::move(ring_ + offset, ring_ + offset + chunk, out);
+        std::destroy_n(ring_ + offset, chunk);
+        std::move(ring_, ring_ + (n - chunk), out);
+        std::destroy_n(ring_, n - chunk);
+        telemetry_.popped(popCursor, n);
+        popCursor_.store(popCursor + n, std::memory_order_release);
+        return n;
+    }
+
 private:
     auto full(size_type pushCursor, size_type popCursor) const noexcept {
         return (pushCursor - popCursor) == capacity_;
@@ -90,6 +208,7 @@ private:
 private:
     size_type capacity_;
     T* ring_;
+    [[no_unique_address]] Telemetry telemetry_;
 
     using CursorType = std::atomic<size_type>;
     static_assert(CursorType::is_always_lock_free);
@@ -0,0 +1,169 @@
+#pragma once
+
+#include "spsc_q3.cpp"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <utility>
+
+
+/// How long a blocked side busy-waits before it parks
+struct WaitBudget
+{
+    /// Retries separated by a pause instruction
+    unsigned spins = 1024;
+    /// Retries separated by std::this_thread::yield()
+    unsigned yields = 64;
+};
+
+
+/// Fifo3 with blocking wait_push/wait_pop
+///
+/// A blocked side spins with a pause instruction, then yields, then parks on
+/// std::atomic::wait (a futex on Linux). Every successful push/pop pays one
+/// full fence to check whether the other side is parked; the notify itself
+/// is only issued when it is. Non-blocking push/pop remain available and wake
+/// a parked peer as well.
+template<typename T, typename Alloc = std::allocator<T>>
+class BlockingFifo3
+{
+public:
+    using value_type = T;
+    using size_type = typename Fifo3<T, Alloc>::size_type;
+
+    explicit BlockingFifo3(size_type capacity, WaitBudget budget = {}, Alloc const& alloc = Alloc{})
+        : fifo_{capacity, alloc}
+        , budget_{budget}
+    {}
+
+
+    /// Returns the number of elements in the fifo
+    auto size() const noexcept { return fifo_.size(); }
+
+    /// Returns whether the container has no elements
+    auto empty() const noexcept { return fifo_.empty(); }
+
+    /// Returns whether the container has capacity_() elements
+    auto full() const noexcept { return fifo_.full(); }
+
+    /// Returns the number of elements that can be held in the fifo
+    auto capacity() const noexcept { return fifo_.capacity(); }
+
+
+    /// Push one object onto the fifo.
+    /// @return `true` if the operation is successful; `false` if fifo is full.
+    auto push(T const& value) {
+        return emplace(value);
+    }
+
+    /// Push one object onto the fifo, moving from `value`.
+    /// @return `true` if the operation is successful; `false` if fifo is full.
+    auto push(T&& value) {
+        return emplace(std::move(value));
+    }
+
+    /// Construct one object in place at the back of the fifo.
+    /// @return `true` if the operation is successful; `false` if fifo is full.
+    template<typename... Args>
+    auto emplace(Args&&... args) {
+        if (not fifo_.emplace(std::forward<Args>(args)...)) {
+            return false;
+        }
+        notify(popWaiter_);
+        return true;
+    }
+
+    /// Pop one object from the fifo.
+    /// @return `true` if the pop operation is successful; `false` if fifo is empty.
+    auto pop(T& value) {
+        if (not fifo_.pop(value)) {
+            return false;
+        }
+        notify(pushWaiter_);
+        return true;
+    }
+
+    /// Push one object onto the fifo, blocking while it is full.
+    void wait_push(T const& value) {
+        wait(pushWaiter_, [&] { return push(value); });
+    }
+
+    /// Push one object onto the fifo, blocking while it is full.
+    void wait_push(T&& value) {
+        wait(pushWaiter_, [&] { return push(std::move(value)); });
+    }
+
+    /// Pop one object from the fifo, blocking while it is empty.
+    void wait_pop(T& value) {
+        wait(popWaiter_, [&] { return pop(value); });
+    }
+
+private:
+    // See Fifo3 for why std::hardware_destructive_interference_size is not used
+    static constexpr auto hardware_destructive_interference_size = std::size_t{64};
+
+    struct alignas(hardware_destructive_interference_size) Waiter
+    {
+        /// Bumped by the notifier; the parked side waits for it to change
+        std::atomic<std::uint32_t> epoch{};
+        /// Set by the parking side before its final retry
+        std::atomic<bool> parked{};
+    };
+
+    static void pause() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__)
+        asm volatile("yield");
+#endif
+    }
+
+    template<typename TryOp>
+    void wait(Waiter& waiter, TryOp tryOp) {
+        for (auto i = 0u; i < budget_.spins; ++i) {
+            if (tryOp()) {
+                return;
+            }
+            pause();
+        }
+        for (auto i = 0u; i < budget_.yields; ++i) {
+            if (tryOp()) {
+                return;
+            }
+            std::this_thread::yield();
+        }
+        while (true) {
+            auto epoch = waiter.epoch.load(std::memory_order_acquire);
+            waiter.parked.store(true, std::memory_order_relaxed);
+            // Pairs with the fence in notify(): either the peer sees `parked`
+            // or this retry sees the peer's cursor update.
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (tryOp()) {
+                waiter.parked.store(false, std::memory_order_relaxed);
+                return;
+            }
+            waiter.epoch.wait(epoch, std::memory_order_acquire);
+            waiter.parked.store(false, std::memory_order_relaxed);
+        }
+    }
+
+    static void notify(Waiter& waiter) noexcept {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiter.parked.load(std::memory_order_relaxed)) {
+            waiter.epoch.fetch_add(1, std::memory_order_release);
+            waiter.epoch.notify_one();
+        }
+    }
+
+private:
+    Fifo3<T, Alloc> fifo_;
+    WaitBudget budget_;
+
+    /// Parked on by the push thread; notified by the pop thread
+    Waiter pushWaiter_;
+
+    /// Parked on by the pop thread; notified by the push thread
+    Waiter popWaiter_;
+};
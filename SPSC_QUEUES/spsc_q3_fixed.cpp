@@ -0,0 +1,213 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <utility>
+
+
+/// Threadsafe, efficient circular FIFO with a compile-time capacity
+///
+/// Same interface as Fifo3, but the capacity must be a power of two so that
+/// cursors are mapped onto slots with a mask instead of an integer division,
+/// and the ring is stored inline so there is no pointer to chase. The object
+/// is as large as its ring; allocate big instances on the heap.
+template<typename T, std::size_t N>
+class FixedFifo3
+{
+    static_assert(N > 0 and (N & (N - 1)) == 0, "capacity must be a power of two");
+
+public:
+    using value_type = T;
+    using size_type = std::size_t;
+
+    FixedFifo3() = default;
+
+    FixedFifo3(FixedFifo3 const&) = delete;
+    FixedFifo3& operator=(FixedFifo3 const&) = delete;
+    FixedFifo3(FixedFifo3&&) = delete;
+    FixedFifo3& operator=(FixedFifo3&&) = delete;
+
+    ~FixedFifo3() {
+        auto pushCursor = pushCursor_.load(std::memory_order_relaxed);
+        for (auto popCursor = popCursor_.load(std::memory_order_relaxed); popCursor != pushCursor; ++popCursor) {
+            element(popCursor)->~T();
+        }
+    }
+
+
+    /// Returns the number of elements in the fifo
+    auto size() const noexcept {
+        auto pushCursor = pushCursor_.load(std::memory_order_relaxed);
+        auto popCursor = popCursor_.load(std::memory_order_relaxed);
+
+        assert(popCursor <= pushCursor);
+        return pushCursor - popCursor;
+    }
+
+    /// Returns whether the container has no elements
+    auto empty() const noexcept { return size() == 0; }
+
+    /// Returns whether the container has capacity_() elements
+    auto full() const noexcept { return size() == capacity(); }
+
+    /// Returns the number of elements that can be held in the fifo
+    static constexpr auto capacity() noexcept { return N; }
+
+
+    /// Push one object onto the fifo.
+    /// @return `true` if the operation is successful; `false` if fifo is full.
+    auto push(T const& value) {
+        return emplace(value);
+    }
+
+    /// Push one object onto the fifo, moving from `value`.
+    /// @return `true` if the operation is successful; `false` if fifo is full.
+    auto push(T&& value) {
+        return emplace(std::move(value));
+    }
+
+    /// Construct one object in place at the back of the fifo.
+    /// @return `true` if the operation is successful; `false` if fifo is full.
+    template<typename... Args>
+    auto emplace(Args&&... args) {
+        auto slot = reserve();
+        if (not slot) {
+            return false;
+        }
+        new (slot) T(std::forward<Args>(args)...);
+        commit();
+        return true;
+    }
+
+    /// Reserve the slot at the back of the fifo without publishing it.
+    /// @return uninitialized storage for one T; `nullptr` if fifo is full.
+    void* reserve() noexcept {
+        auto pushCursor = pushCursor_.load(std::memory_order_relaxed);
+        auto popCursor = popCursor_.load(std::memory_order_acquire);
+        if (full(pushCursor, popCursor)) {
+            return nullptr;
+        }
+        return element(pushCursor);
+    }
+
+    /// Publish the object constructed in the slot returned by reserve().
+    void commit() noexcept {
+        auto pushCursor = pushCursor_.load(std::memory_order_relaxed);
+        pushCursor_.store(pushCursor + 1, std::memory_order_release);
+    }
+
+    /// Pop one object from the fifo.
+    /// @return `true` if the pop operation is successful; `false` if fifo is empty.
+    auto pop(T& value) {
+        auto pushCursor = pushCursor_.load(std::memory_order_acquire);
+        auto popCursor = popCursor_.load(std::memory_order_relaxed);
+        if (empty(pushCursor, popCursor)) {
+            return false;
+        }
+        value = std::move(*element(popCursor));
+        element(popCursor)->~T();
+        popCursor_.store(popCursor + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// Access the object at the front of the fifo in place.
+    /// @return pointer to the front object; `nullptr` if fifo is empty.
+    T* front() noexcept {
+        auto pushCursor = pushCursor_.load(std::memory_order_acquire);
+        auto popCursor = popCursor_.load(std::memory_order_relaxed);
+        if (empty(pushCursor, popCursor)) {
+            return nullptr;
+        }
+        return element(popCursor);
+    }
+
+    /// Destroy the front object and hand its slot back to the producer.
+    void release() noexcept {
+        auto popCursor = popCursor_.load(std::memory_order_relaxed);
+        element(popCursor)->~T();
+        popCursor_.store(popCursor + 1, std::memory_order_release);
+    }
+
+    /// Push up to `count` objects read from `first` onto the fifo.
+    /// @return the number of objects pushed; `0` if fifo is full.
+    template<std::input_iterator InputIt>
+    auto push_n(InputIt first, size_type count) {
+        auto pushCursor = pushCursor_.load(std::memory_order_relaxed);
+        auto popCursor = popCursor_.load(std::memory_order_acquire);
+        auto n = std::min(count, N - (pushCursor - popCursor));
+        if (n == 0) {
+            return n;
+        }
+        auto offset = pushCursor & mask;
+        auto chunk = std::min(n, N - offset);
+        first = std::ranges::uninitialized_copy_n(
+            first, chunk, data() + offset, data() + offset + chunk).in;
+        std::ranges::uninitialized_copy_n(first, n - chunk, data(), data() + (n - chunk));
+        pushCursor_.store(pushCursor + n, std::memory_order_release);
+        return n;
+    }
+
+    /// Pop up to `count` objects from the fifo into `out`.
+    /// @return the number of objects popped; `0` if fifo is empty.
+    template<typename OutputIt>
+    auto pop_n(OutputIt out, size_type count) {
+        auto pushCursor = pushCursor_.load(std::memory_order_acquire);
+        auto popCursor = popCursor_.load(std::memory_order_relaxed);
+        auto n = std::min(count, pushCursor - popCursor);
+        if (n == 0) {
+            return n;
+        }
+        auto offset = popCursor & mask;
+        auto chunk = std::min(n, N - offset);
+        out = std::move(data() + offset, data() + offset + chunk, out);
+        std::destroy_n(data() + offset, chunk);
+        std::move(data(), data() + (n - chunk), out);
+        std::destroy_n(data(), n - chunk);
+        popCursor_.store(popCursor + n, std::memory_order_release);
+        return n;
+    }
+
+private:
+    static constexpr auto mask = N - 1;
+
+    static auto full(size_type pushCursor, size_type popCursor) noexcept {
+        return (pushCursor - popCursor) == N;
+    }
+    static auto empty(size_type pushCursor, size_type popCursor) noexcept {
+        return pushCursor == popCursor;
+    }
+    auto data() noexcept {
+        return reinterpret_cast<T*>(ring_.data());
+    }
+    auto element(size_type cursor) noexcept {
+        return data() + (cursor & mask);
+    }
+
+private:
+    using CursorType = std::atomic<size_type>;
+    static_assert(CursorType::is_always_lock_free);
+
+    // See Fifo3 for why std::hardware_destructive_interference_size is not used
+    static constexpr auto hardware_destructive_interference_size = size_type{64};
+
+    /// Loaded and stored by the push thread; loaded by the pop thread
+    alignas(hardware_destructive_interference_size) CursorType pushCursor_{};
+
+    /// Loaded and stored by the pop thread; loaded by the push thread
+    alignas(hardware_destructive_interference_size) CursorType popCursor_{};
+
+    /// Raw storage for one T; the array has the same layout as T[N]
+    struct Slot {
+        alignas(T) std::byte bytes[sizeof(T)];
+    };
+    static_assert(sizeof(Slot) == sizeof(T));
+
+    /// Starts on its own cache line, after the cursors
+    alignas(hardware_destructive_interference_size) std::array<Slot, N> ring_;
+};
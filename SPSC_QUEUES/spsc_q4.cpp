@@ -0,0 +1,139 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <memory>
+#include <new>
+
+#include "spsc_telemetry.cpp"
+
+
+/// Threadsafe, efficient circular FIFO with cached cursors
+///
+/// Same interface as Fifo3, but each side keeps a private copy of the other
+/// side's cursor and only reloads it when the fifo looks full (producer) or
+/// empty (consumer). In steady state push and pop touch only their own cache
+/// lines, so the cursors stop bouncing between cores.
+///
+/// `Telemetry` is the same compile-time policy as in Fifo3. Occupancy is
+/// measured against the cached pop cursor, so the high-water mark is an
+/// upper bound.
+template<typename T, typename Alloc = std::allocator<T>, typename Telemetry = NoTelemetry>
+class Fifo4 : private Alloc
+{
+public:
+    using value_type = T;
+    using allocator_traits = std::allocator_traits<Alloc>;
+    using size_type = typename allocator_traits::size_type;
+
+    explicit Fifo4(size_type capacity, Alloc const& alloc = Alloc{})
+        : Alloc{alloc}
+        , capacity_{capacity}
+        , ring_{allocator_traits::allocate(*this, capacity)}
+        , telemetry_{capacity}
+    {}
+
+    ~Fifo4() {
+        while(not empty()) {
+            element(popCursor_)->~T();
+            ++popCursor_;
+        }
+        allocator_traits::deallocate(*this, ring_, capacity_);
+    }
+
+
+    /// Returns the number of elements in the fifo
+    auto size() const noexcept {
+        auto pushCursor = pushCursor_.load(std::memory_order_relaxed);
+        auto popCursor = popCursor_.load(std::memory_order_relaxed);
+
+        assert(popCursor <= pushCursor);
+        return pushCursor - popCursor;
+    }
+
+    /// Returns whether the container has no elements
+    auto empty() const noexcept { return size() == 0; }
+
+    /// Returns whether the container has capacity_() elements
+    auto full() const noexcept { return size() == capacity(); }
+
+    /// Returns the number of elements that can be held in the fifo
+    auto capacity() const noexcept { return capacity_; }
+
+    /// Returns a snapshot of the telemetry counters; callable from any thread
+    auto stats() const noexcept { return telemetry_.snapshot(); }
+
+
+    /// Push one object onto the fifo.
+    /// @return `true` if the operation is successful; `false` if fifo is full.
+    auto push(T const& value) {
+        auto pushCursor = pushCursor_.load(std::memory_order_relaxed);
+        if (full(pushCursor, popCursorCached_)) {
+            popCursorCached_ = popCursor_.load(std::memory_order_acquire);
+            if (full(pushCursor, popCursorCached_)) {
+                telemetry_.full();
+                return false;
+            }
+        }
+        telemetry_.occupancy(pushCursor - popCursorCached_ + 1);
+        new (element(pushCursor)) T(value);
+        telemetry_.pushed(pushCursor);
+        pushCursor_.store(pushCursor + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// Pop one object from the fifo.
+    /// @return `true` if the pop operation is successful; `false` if fifo is empty.
+    auto pop(T& value) {
+        auto popCursor = popCursor_.load(std::memory_order_relaxed);
+        if (empty(pushCursorCached_, popCursor)) {
+            pushCursorCached_ = pushCursor_.load(std::memory_order_acquire);
+            if (empty(pushCursorCached_, popCursor)) {
+                telemetry_.empty();
+                return false;
+            }
+        }
+        value = *element(popCursor);
+        element(popCursor)->~T();
+        telemetry_.popped(popCursor);
+        popCursor_.store(popCursor + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    auto full(size_type pushCursor, size_type popCursor) const noexcept {
+        return (pushCursor - popCursor) == capacity_;
+    }
+    static auto empty(size_type pushCursor, size_type popCursor) noexcept {
+        return pushCursor == popCursor;
+    }
+    auto element(size_type cursor) noexcept {
+        return &ring_[cursor % capacity_];
+    }
+
+private:
+    size_type capacity_;
+    T* ring_;
+    [[no_unique_address]] Telemetry telemetry_;
+
+    using CursorType = std::atomic<size_type>;
+    static_assert(CursorType::is_always_lock_free);
+
+    // See Fifo3 for why std::hardware_destructive_interference_size is not used
+    static constexpr auto hardware_destructive_interference_size = size_type{64};
+
+    /// Loaded and stored by the push thread; loaded by the pop thread
+    alignas(hardware_destructive_interference_size) CursorType pushCursor_{};
+
+    /// Exclusive to the push thread
+    size_type popCursorCached_{};
+
+    /// Loaded and stored by the pop thread; loaded by the push thread
+    alignas(hardware_destructive_interference_size) CursorType popCursor_{};
+
+    /// Exclusive to the pop thread
+    size_type pushCursorCached_{};
+
+    // Padding to avoid false sharing with adjacent objects
+    char padding_[hardware_destructive_interference_size - 2 * sizeof(size_type)];
+};
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+
+/// Point-in-time copy of a queue's telemetry counters
+struct QueueStats
+{
+    std::uint64_t pushes = 0;
+    std::uint64_t pops = 0;
+    /// push attempts rejected because the fifo was full
+    std::uint64_t fullRejects = 0;
+    /// pop attempts rejected because the fifo was empty
+    std::uint64_t emptyRejects = 0;
+    /// Largest occupancy seen by the producer
+    std::uint64_t highWater = 0;
+
+    /// Enqueue-to-dequeue latency of sampled elements, in timestamp ticks
+    std::uint64_t dwellSamples = 0;
+    std::uint64_t dwellTotalTicks = 0;
+    std::uint64_t dwellMaxTicks = 0;
+    /// dwellHistogram[i] counts samples with bit_width(ticks) == i
+    std::array<std::uint64_t, 65> dwellHistogram{};
+};
+
+
+/// Telemetry policy that records nothing and compiles away
+struct NoTelemetry
+{
+    explicit NoTelemetry(std::size_t /*capacity*/) noexcept {}
+
+    void occupancy(std::size_t /*size*/) noexcept {}
+    void full() noexcept {}
+    void pushed(std::size_t /*cursor*/, std::size_t /*count*/ = 1) noexcept {}
+    void empty() noexcept {}
+    void popped(std::size_t /*cursor*/, std::size_t /*count*/ = 1) noexcept {}
+
+    QueueStats snapshot() const noexcept { return {}; }
+};
+
+
+/// Telemetry policy for the SPSC fifos
+///
+/// Producer and consumer counters live on separate cache lines and are only
+/// ever stored by their own side, so updating them is a plain store. Every
+/// SampleEvery-th element is stamped with the timestamp counter on push and
+/// its dwell time is recorded on pop. A monitoring thread may call
+/// snapshot() at any time; counters from the two sides are read
+/// independently and need not be mutually consistent.
+template<std::size_t SampleEvery = 1024>
+class QueueTelemetry
+{
+    static_assert(SampleEvery > 0 and (SampleEvery & (SampleEvery - 1)) == 0,
+                  "sampling interval must be a power of two");
+
+public:
+    explicit QueueTelemetry(std::size_t capacity)
+        // A stamp is only reused after the element it belongs to was popped
+        : stampCount_{capacity / SampleEvery + 1}
+        , stamps_{std::make_unique<Counter[]>(stampCount_)}
+    {}
+
+    /// Producer: the fifo is about to hold `size` elements
+    void occupancy(std::size_t size) noexcept {
+        if (size > producer_.highWater.load(std::memory_order_relaxed)) {
+            producer_.highWater.store(size, std::memory_order_relaxed);
+        }
+    }
+
+    /// Producer: a push was rejected
+    void full() noexcept { bump(producer_.fullRejects); }
+
+    /// Producer: elements [cursor, cursor + count) are about to be published
+    void pushed(std::size_t cursor, std::size_t count = 1) noexcept {
+        bump(producer_.pushes, count);
+        // A batch may span several sampled cursors; each one gets a stamp so
+        // the pop that reaches it never reads a stale one.
+        auto sampled = firstSampled(cursor);
+        if (sampled < cursor + count) {
+            auto ticks = now();
+            for (; sampled < cursor + count; sampled += SampleEvery) {
+                stamp(sampled).store(ticks, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /// Consumer: a pop was rejected
+    void empty() noexcept { bump(consumer_.emptyRejects); }
+
+    /// Consumer: elements [cursor, cursor + count) were just consumed
+    void popped(std::size_t cursor, std::size_t count = 1) noexcept {
+        bump(consumer_.pops, count);
+        auto sampled = firstSampled(cursor);
+        if (sampled < cursor + count) {
+            auto popTicks = now();
+            for (; sampled < cursor + count; sampled += SampleEvery) {
+                auto ticks = popTicks - stamp(sampled).load(std::memory_order_relaxed);
+                bump(consumer_.dwellSamples);
+                bump(consumer_.dwellTotalTicks, ticks);
+                if (ticks > consumer_.dwellMaxTicks.load(std::memory_order_relaxed)) {
+                    consumer_.dwellMaxTicks.store(ticks, std::memory_order_relaxed);
+                }
+                bump(consumer_.dwellHistogram[std::bit_width(ticks)]);
+            }
+        }
+    }
+
+    QueueStats snapshot() const noexcept {
+        QueueStats stats;
+        stats.pushes = producer_.pushes.load(std::memory_order_relaxed);
+        stats.fullRejects = producer_.fullRejects.load(std::memory_order_relaxed);
+        stats.highWater = producer_.highWater.load(std::memory_order_relaxed);
+        stats.pops = consumer_.pops.load(std::memory_order_relaxed);
+        stats.emptyRejects = consumer_.emptyRejects.load(std::memory_order_relaxed);
+        stats.dwellSamples = consumer_.dwellSamples.load(std::memory_order_relaxed);
+        stats.dwellTotalTicks = consumer_.dwellTotalTicks.load(std::memory_order_relaxed);
+        stats.dwellMaxTicks = consumer_.dwellMaxTicks.load(std::memory_order_relaxed);
+        for (std::size_t i = 0; i < stats.dwellHistogram.size(); ++i) {
+            stats.dwellHistogram[i] = consumer_.dwellHistogram[i].load(std::memory_order_relaxed);
+        }
+        return stats;
+    }
+
+private:
+    using Counter = std::atomic<std::uint64_t>;
+    static_assert(Counter::is_always_lock_free);
+
+    /// Single-writer increment; no read-modify-write needed
+    static void bump(Counter& counter, std::uint64_t n = 1) noexcept {
+        counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    static std::uint64_t now() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+    }
+
+    /// First sampled cursor at or after `cursor`
+    static std::size_t firstSampled(std::size_t cursor) noexcept {
+        return (cursor + SampleEvery - 1) & ~(SampleEvery - 1);
+    }
+
+    Counter& stamp(std::size_t cursor) noexcept {
+        return stamps_[(cursor / SampleEvery) % stampCount_];
+    }
+
+    // See Fifo3 for why std::hardware_destructive_interference_size is not used
+    static constexpr auto hardware_destructive_interference_size = std::size_t{64};
+
+    /// Stored by the push thread only
+    struct alignas(hardware_destructive_interference_size) ProducerSide
+    {
+        Counter pushes{};
+        Counter fullRejects{};
+        Counter highWater{};
+    };
+
+    /// Stored by the pop thread only
+    struct alignas(hardware_destructive_interference_size) ConsumerSide
+    {
+        Counter pops{};
+        Counter emptyRejects{};
+        Counter dwellSamples{};
+        Counter dwellTotalTicks{};
+        Counter dwellMaxTicks{};
+        std::array<Counter, 65> dwellHistogram{};
+    };
+
+    std::size_t stampCount_;
+    /// Stored by the push thread before publishing; loaded by the pop thread
+    std::unique_ptr<Counter[]> stamps_;
+    ProducerSide producer_;
+    ConsumerSide consumer_;
+};
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+
+
+/// Threadsafe unbounded FIFO built from linked fixed-size segments
+///
+/// The producer never fails: when the current segment fills it links in a
+/// segment the consumer has already drained, or allocates one if none is
+/// free. Drained segments stay on the list behind the consumer until the
+/// producer recycles them, so once the queue has grown to its working size
+/// nothing is allocated any more. Within a segment push and pop cost the
+/// same as Fifo4 plus one branch on the segment boundary.
+template<typename T, std::size_t SegmentSize = 1024, typename Alloc = std::allocator<T>>
+class SegmentedFifo
+{
+    static_assert(SegmentSize > 0 and (SegmentSize & (SegmentSize - 1)) == 0,
+                  "segment size must be a power of two");
+
+    struct Segment
+    {
+        struct Slot {
+            alignas(T) std::byte bytes[sizeof(T)];
+        };
+        Slot slots[SegmentSize];
+        /// Stored by the push thread; loaded by the pop thread
+        std::atomic<Segment*> next{nullptr};
+
+        auto element(std::size_t cursor) noexcept {
+            return reinterpret_cast<T*>(&slots[cursor & (SegmentSize - 1)]);
+        }
+    };
+
+    using SegmentAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<Segment>;
+
+public:
+    using value_type = T;
+    using allocator_traits = std::allocator_traits<SegmentAlloc>;
+    using size_type = typename allocator_traits::size_type;
+
+    explicit SegmentedFifo(Alloc const& alloc = Alloc{})
+        : alloc_{alloc}
+    {
+        auto segment = allocate();
+        first_ = headCached_ = tail_ = segment;
+        head_.store(segment, std::memory_order_relaxed);
+    }
+
+    SegmentedFifo(SegmentedFifo const&) = delete;
+    SegmentedFifo& operator=(SegmentedFifo const&) = delete;
+    SegmentedFifo(SegmentedFifo&&) = delete;
+    SegmentedFifo& operator=(SegmentedFifo&&) = delete;
+
+    ~SegmentedFifo() {
+        auto pushCursor = pushCursor_.load(std::memory_order_relaxed);
+        auto head = head_.load(std::memory_order_relaxed);
+        for (auto popCursor = popCursor_.load(std::memory_order_relaxed); popCursor != pushCursor; ++popCursor) {
+            if (boundary(popCursor)) {
+                head = head->next.load(std::memory_order_relaxed);
+            }
+            head->element(popCursor)->~T();
+        }
+        for (auto segment = first_; segment;) {
+            auto next = segment->next.load(std::memory_order_relaxed);
+            allocator_traits::destroy(alloc_, segment);
+            allocator_traits::deallocate(alloc_, segment, 1);
+            segment = next;
+        }
+    }
+
+
+    /// Returns the number of elements in the fifo
+    auto size() const noexcept {
+        auto pushCursor = pushCursor_.load(std::memory_order_relaxed);
+        auto popCursor = popCursor_.load(std::memory_order_relaxed);
+
+        assert(popCursor <= pushCursor);
+        return pushCursor - popCursor;
+    }
+
+    /// Returns whether the container has no elements
+    auto empty() const noexcept { return size() == 0; }
+
+
+    /// Push one object onto the fifo.
+    /// @return always `true`; kept for drop-in compatibility with Fifo3.
+    auto push(T const& value) {
+        return emplace(value);
+    }
+
+    /// Push one object onto the fifo, moving from `value`.
+    /// @return always `true`; kept for drop-in compatibility with Fifo3.
+    auto push(T&& value) {
+        return emplace(std::move(value));
+    }
+
+    /// Construct one object in place at the back of the fifo.
+    /// @return always `true`; kept for drop-in compatibility with Fifo3.
+    template<typename... Args>
+    auto emplace(Args&&... args) {
+        auto pushCursor = pushCursor_.load(std::memory_order_relaxed);
+        if (boundary(pushCursor)) {
+            auto segment = recycle();
+            segment->next.store(nullptr, std::memory_order_relaxed);
+            tail_->next.store(segment, std::memory_order_release);
+            tail_ = segment;
+        }
+        new (tail_->element(pushCursor)) T(std::forward<Args>(args)...);
+        pushCursor_.store(pushCursor + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// Pop one object from the fifo.
+    /// @return `true` if the pop operation is successful; `false` if fifo is empty.
+    auto pop(T& value) {
+        auto popCursor = popCursor_.load(std::memory_order_relaxed);
+        if (popCursor == pushCursorCached_) {
+            pushCursorCached_ = pushCursor_.load(std::memory_order_acquire);
+            if (popCursor == pushCursorCached_) {
+                return false;
+            }
+        }
+        auto head = head_.load(std::memory_order_relaxed);
+        if (boundary(popCursor)) {
+            // The previous segment is drained; hand it back to the producer
+            head = head->next.load(std::memory_order_acquire);
+            head_.store(head, std::memory_order_release);
+        }
+        auto element = head->element(popCursor);
+        value = std::move(*element);
+        element->~T();
+        popCursor_.store(popCursor + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    /// Whether `cursor` is the first slot of a segment other than the initial one
+    static auto boundary(size_type cursor) noexcept {
+        return cursor != 0 and (cursor & (SegmentSize - 1)) == 0;
+    }
+
+    Segment* allocate() {
+        auto segment = allocator_traits::allocate(alloc_, 1);
+        allocator_traits::construct(alloc_, segment);
+        return segment;
+    }
+
+    /// Takes the oldest drained segment, or allocates one if there is none
+    Segment* recycle() {
+        if (first_ == headCached_) {
+            headCached_ = head_.load(std::memory_order_acquire);
+            if (first_ == headCached_) {
+                return allocate();
+            }
+        }
+        auto segment = first_;
+        first_ = first_->next.load(std::memory_order_relaxed);
+        return segment;
+    }
+
+private:
+    SegmentAlloc alloc_;
+
+    using CursorType = std::atomic<size_type>;
+    static_assert(CursorType::is_always_lock_free);
+
+    // See Fifo3 for why std::hardware_destructive_interference_size is not used
+    static constexpr auto hardware_destructive_interference_size = size_type{64};
+
+    /// Loaded and stored by the push thread; loaded by the pop thread
+    alignas(hardware_destructive_interference_size) CursorType pushCursor_{};
+
+    /// Exclusive to the push thread: segment being filled, oldest segment on
+    /// the list and last known consumer segment
+    Segment* tail_;
+    Segment* first_;
+    Segment* headCached_;
+
+    /// Loaded and stored by the pop thread; loaded by the push thread
+    alignas(hardware_destructive_interference_size) CursorType popCursor_{};
+
+    /// Stored by the pop thread; loaded by the push thread to find drained segments
+    std::atomic<Segment*> head_;
+
+    /// Exclusive to the pop thread
+    size_type pushCursorCached_{};
+
+    // Padding to avoid false sharing with adjacent objects
+    char padding_[hardware_destructive_interference_size - 2 * sizeof(size_type) - sizeof(Segment*)];
+};
@@ -0,0 +1,138 @@
+#include <benchmark/benchmark.h>
+#include "work_stealing_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+
+/// Baseline: every worker takes jobs from one std::queue behind one mutex
+class MutexQueuePool
+{
+public:
+    explicit MutexQueuePool(std::size_t threads) {
+        for (std::size_t i = 0; i < threads; ++i) {
+            workers_.emplace_back([this] {
+                while (true) {
+                    std::function<void()> job;
+                    {
+                        std::unique_lock lock(mutex_);
+                        ready_.wait(lock, [this] { return stop_ or not jobs_.empty(); });
+                        if (stop_ and jobs_.empty()) {
+                            return;
+                        }
+                        job = std::move(jobs_.front());
+                        jobs_.pop();
+                    }
+                    job();
+                }
+            });
+        }
+    }
+
+    ~MutexQueuePool() {
+        {
+            std::lock_guard lock(mutex_);
+            stop_ = true;
+        }
+        ready_.notify_all();
+        for (auto& worker : workers_) {
+            worker.join();
+        }
+    }
+
+    template<typename F>
+    void submit(F&& fn) {
+        {
+            std::lock_guard lock(mutex_);
+            jobs_.emplace(std::forward<F>(fn));
+        }
+        ready_.notify_one();
+    }
+
+    /// One job per grain-sized chunk, all through the central queue
+    template<typename F>
+    void parallel_for(std::size_t begin, std::size_t end, std::size_t grain, F&& fn) {
+        std::atomic<std::size_t> pending{0};
+        for (auto chunk = begin; chunk < end; chunk += grain) {
+            auto last = std::min(chunk + grain, end);
+            pending.fetch_add(1, std::memory_order_relaxed);
+            submit([chunk, last, &fn, &pending] {
+                for (auto i = chunk; i < last; ++i) {
+                    fn(i);
+                }
+                pending.fetch_sub(1, std::memory_order_release);
+            });
+        }
+        while (pending.load(std::memory_order_acquire) != 0) {
+            std::this_thread::yield();
+        }
+    }
+
+private:
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable ready_;
+    std::queue<std::function<void()>> jobs_;
+    bool stop_ = false;
+};
+
+
+static constexpr std::size_t kItems = 1 << 20;
+
+/// range(0) workers, range(1) items per job
+template<typename Pool>
+static void BM_ParallelFor(benchmark::State& state) {
+    Pool pool(state.range(0));
+    std::vector<double> out(kItems);
+    for (auto _ : state) {
+        pool.parallel_for(0, kItems, state.range(1),
+                          [&out](std::size_t i) { out[i] = std::sqrt(double(i)); });
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(state.iterations() * kItems);
+}
+
+static std::uint64_t fib(WorkStealingPool& pool, int n) {
+    if (n < 20) {
+        return n < 2 ? n : fib(pool, n - 1) + fib(pool, n - 2);
+    }
+    std::uint64_t left = 0;
+    TaskGroup group(pool);
+    group.run([&] { left = fib(pool, n - 1); });
+    auto right = fib(pool, n - 2);
+    group.wait();
+    return left + right;
+}
+
+/// Nested fork/join; the mutex pool has no way to help while it waits
+static void BM_ForkJoinFib(benchmark::State& state) {
+    WorkStealingPool pool(state.range(0));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(fib(pool, 30));
+    }
+}
+
+BENCHMARK(BM_ParallelFor<WorkStealingPool>)
+    ->ArgNames({"threads", "grain"})
+    ->ArgsProduct({{1, 2, 4, 8}, {64, 1024}})
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ParallelFor<MutexQueuePool>)
+    ->ArgNames({"threads", "grain"})
+    ->ArgsProduct({{1, 2, 4, 8}, {64, 1024}})
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ForkJoinFib)
+    ->ArgName("threads")
+    ->Arg(1)->Arg(2)->Arg(4)->Arg(8)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_MAIN();
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <vector>
+
+
+/// Chase-Lev work-stealing deque (Le, Pop, Cohen, Zappa Nardelli, PPoPP'13)
+///
+/// The owning thread pushes and pops at the bottom like a stack; any other
+/// thread may steal from the top. Only the last element is ever contended.
+/// The ring grows on demand; replaced rings are kept until the deque is
+/// destroyed because a thief may still be reading from them.
+template<typename T>
+class ChaseLevDeque
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+
+    struct Ring
+    {
+        explicit Ring(std::int64_t capacity)
+            : capacity{capacity}
+            , slots{new std::atomic<T>[capacity]}
+        {}
+
+        T get(std::int64_t i) const noexcept {
+            return slots[i & (capacity - 1)].load(std::memory_order_relaxed);
+        }
+        void put(std::int64_t i, T value) noexcept {
+            slots[i & (capacity - 1)].store(value, std::memory_order_relaxed);
+        }
+
+        std::int64_t capacity;
+        std::unique_ptr<std::atomic<T>[]> slots;
+    };
+
+public:
+    /// `capacity` must be a power of two; slots are indexed by masking
+    explicit ChaseLevDeque(std::int64_t capacity = 1024) {
+        assert(capacity > 0 and (capacity & (capacity - 1)) == 0);
+        rings_.push_back(std::make_unique<Ring>(capacity));
+        ring_.store(rings_.back().get(), std::memory_order_relaxed);
+    }
+
+    ChaseLevDeque(ChaseLevDeque const&) = delete;
+    ChaseLevDeque& operator=(ChaseLevDeque const&) = delete;
+
+
+    /// Push one object onto the bottom; owner thread only.
+    /// Grows the ring instead of failing.
+    void push(T value) {
+        auto bottom = bottom_.load(std::memory_order_relaxed);
+        auto top = top_.load(std::memory_order_acquire);
+        auto ring = ring_.load(std::memory_order_relaxed);
+        if (bottom - top > ring->capacity - 1) {
+            ring = grow(ring, bottom, top);
+        }
+        ring->put(bottom, value);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom_.store(bottom + 1, std::memory_order_relaxed);
+    }
+
+    /// Pop the newest object from the bottom; owner thread only.
+    /// @return the object; `std::nullopt` if the deque is empty or a thief
+    /// took the last element first.
+    std::optional<T> pop() {
+        auto bottom = bottom_.load(std::memory_order_relaxed) - 1;
+        auto ring = ring_.load(std::memory_order_relaxed);
+        bottom_.store(bottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto top = top_.load(std::memory_order_relaxed);
+
+        if (top > bottom) { // empty
+            bottom_.store(bottom + 1, std::memory_order_relaxed);
+            return std::nullopt;
+        }
+        auto value = ring->get(bottom);
+        if (top == bottom) { // last element: race the thieves for it
+            bool won = top_.compare_exchange_strong(top, top + 1,
+                                                    std::memory_order_seq_cst,
+                                                    std::memory_order_relaxed);
+            bottom_.store(bottom + 1, std::memory_order_relaxed);
+            if (not won) {
+                return std::nullopt;
+            }
+        }
+        return value;
+    }
+
+    /// Steal the oldest object from the top; any thread.
+    /// @return the object; `std::nullopt` if the deque is empty or another
+    /// thread won the race for the element.
+    std::optional<T> steal() {
+        auto top = top_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto bottom = bottom_.load(std::memory_order_acquire);
+        if (top >= bottom) {
+            return std::nullopt;
+        }
+        auto value = ring_.load(std::memory_order_acquire)->get(top);
+        if (not top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                             std::memory_order_relaxed)) {
+            return std::nullopt;
+        }
+        return value;
+    }
+
+    /// Returns the number of elements; approximate while other threads are active
+    std::int64_t size() const noexcept {
+        auto bottom = bottom_.load(std::memory_order_relaxed);
+        auto top = top_.load(std::memory_order_relaxed);
+        return bottom > top ? bottom - top : 0;
+    }
+
+    /// Returns whether the deque has no elements
+    bool empty() const noexcept { return size() == 0; }
+
+private:
+    Ring* grow(Ring* ring, std::int64_t bottom, std::int64_t top) {
+        auto bigger = std::make_unique<Ring>(ring->capacity * 2);
+        for (auto i = top; i < bottom; ++i) {
+            bigger->put(i, ring->get(i));
+        }
+        rings_.push_back(std::move(bigger));
+        ring_.store(rings_.back().get(), std::memory_order_release);
+        return rings_.back().get();
+    }
+
+private:
+    /// Loaded and CASed by every thief and by the owner
+    alignas(64) std::atomic<std::int64_t> top_{0};
+
+    /// Stored by the owner only; loaded by thieves
+    alignas(64) std::atomic<std::int64_t> bottom_{0};
+
+    /// Current ring; replaced by the owner when it grows
+    std::atomic<Ring*> ring_;
+
+    /// Every ring ever used; exclusive to the owner
+    std::vector<std::unique_ptr<Ring>> rings_;
+};
@@ -0,0 +1,135 @@
+// Instantiates ChaseLevDeque and WorkStealingPool and checks basic
+// behaviour, single-threaded and with thieves racing the owner. Built with
+// the benchmarks so that a header that stops compiling breaks the build;
+// run it to catch a job or element that is lost or run twice.
+#include "work_stealing_pool.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+#include <vector>
+
+
+// Unlike assert(), stays active in Release builds
+#define CHECK(cond)                                                                 \
+    do {                                                                            \
+        if (not (cond)) {                                                           \
+            std::fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__,  \
+                         #cond);                                                    \
+            std::abort();                                                           \
+        }                                                                           \
+    } while (0)
+
+static void smokeDeque() {
+    // The owner pops newest first, thieves steal oldest first, and the ring
+    // grows well past its initial capacity
+    {
+        ChaseLevDeque<int> deque(4);
+        CHECK(not deque.pop() and not deque.steal());
+        for (int i = 0; i < 100; ++i) {
+            deque.push(i);
+        }
+        CHECK(deque.size() == 100);
+        CHECK(deque.steal() == 0 and deque.steal() == 1);
+        CHECK(deque.pop() == 99 and deque.pop() == 98);
+        for (int i = 2; i < 98; ++i) {
+            CHECK(deque.steal() == i);
+        }
+        CHECK(deque.size() == 0 and not deque.pop());
+    }
+
+    // Two thieves race the owner: every element is taken exactly once
+    constexpr int count = 100'000;
+    ChaseLevDeque<int> deque(16);
+    auto taken = std::make_unique<std::atomic<int>[]>(count);
+    std::atomic<bool> done{false};
+    auto take = [&](int value) {
+        CHECK(value >= 0 and value < count);
+        CHECK(taken[value].fetch_add(1, std::memory_order_relaxed) == 0);
+    };
+    std::vector<std::thread> thieves;
+    for (int t = 0; t < 2; ++t) {
+        thieves.emplace_back([&] {
+            while (not done.load(std::memory_order_acquire)) {
+                if (auto value = deque.steal()) {
+                    take(*value);
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (int i = 0; i < count; ++i) {
+        deque.push(i);
+        if (i % 3 == 0) {
+            if (auto value = deque.pop()) {
+                take(*value);
+            }
+        }
+    }
+    while (auto value = deque.pop()) {
+        take(*value);
+    }
+    done.store(true, std::memory_order_release);
+    for (auto& thief : thieves) {
+        thief.join();
+    }
+    for (int i = 0; i < count; ++i) {
+        CHECK(taken[i].load() == 1);
+    }
+}
+
+/// Forks fib(n - 1) onto `pool` and computes fib(n - 2) itself, so jobs
+/// spawn jobs
+static std::uint64_t fib(WorkStealingPool& pool, unsigned n) {
+    if (n < 2) {
+        return n;
+    }
+    std::uint64_t a = 0, b = 0;
+    TaskGroup group(pool);
+    group.run([&] { a = fib(pool, n - 1); });
+    b = fib(pool, n - 2);
+    group.wait();
+    return a + b;
+}
+
+static void smokePool() {
+    WorkStealingPool pool(2);
+    CHECK(pool.size() == 2);
+
+    // Jobs submitted from outside go through the injection queue
+    {
+        std::atomic<int> ran{0};
+        TaskGroup group(pool);
+        for (int i = 0; i < 1000; ++i) {
+            group.run([&] { ran.fetch_add(1, std::memory_order_relaxed); });
+        }
+        group.wait();
+        CHECK(ran.load() == 1000);
+    }
+
+    // Every index is visited once, whatever the grain
+    for (std::size_t grain : {0, 1, 7, 1000}) {
+        constexpr std::size_t count = 10'000;
+        auto visits = std::make_unique<std::atomic<int>[]>(count);
+        pool.parallel_for(0, count, grain, [&](std::size_t i) {
+            visits[i].fetch_add(1, std::memory_order_relaxed);
+        });
+        for (std::size_t i = 0; i < count; ++i) {
+            CHECK(visits[i].load() == 1);
+        }
+    }
+
+    // Nested groups: waiting workers run other jobs instead of blocking
+    CHECK(fib(pool, 20) == 6765);
+    CHECK(not pool.runOne());
+}
+
+int main() {
+    smokeDeque();
+    smokePool();
+    std::puts("smoke_pool: ok");
+}
@@ -0,0 +1,272 @@
+#pragma once
+
+#include "chase_lev_deque.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+
+/// Fixed-size thread pool in which every worker owns a ChaseLevDeque
+///
+/// Jobs submitted from a worker go onto the bottom of its own deque and are
+/// popped from there, newest first; idle workers steal the oldest job from
+/// the top of a random victim. Jobs from threads outside the pool go through
+/// a small mutex-protected injection queue. Workers with nothing to do spin
+/// briefly and then sleep on a futex until new work is submitted.
+class WorkStealingPool
+{
+public:
+    explicit WorkStealingPool(std::size_t threads = std::thread::hardware_concurrency()) {
+        if (threads == 0) {
+            threads = 1;
+        }
+        for (std::size_t i = 0; i < threads; ++i) {
+            workers_.push_back(std::make_unique<Worker>());
+            workers_.back()->rng = 0x9E3779B97F4A7C15ull * (i + 1);
+        }
+        for (std::size_t i = 0; i < threads; ++i) {
+            workers_[i]->thread = std::thread([this, i] { workerLoop(i); });
+        }
+    }
+
+    WorkStealingPool(WorkStealingPool const&) = delete;
+    WorkStealingPool& operator=(WorkStealingPool const&) = delete;
+
+    /// Jobs still queued are dropped; wait for them with a TaskGroup first.
+    ~WorkStealingPool() {
+        stop_.store(true, std::memory_order_relaxed);
+        epoch_.fetch_add(1, std::memory_order_release);
+        epoch_.notify_all();
+        for (auto& worker : workers_) {
+            worker->thread.join();
+        }
+        for (auto& worker : workers_) {
+            while (auto job = worker->deque.pop()) {
+                delete *job;
+            }
+        }
+        for (auto job : inject_) {
+            delete job;
+        }
+    }
+
+
+    /// Returns the number of worker threads
+    std::size_t size() const noexcept { return workers_.size(); }
+
+    /// Queue `fn` to run on some worker; any thread.
+    template<typename F>
+    void submit(F&& fn) {
+        auto job = new Job(std::forward<F>(fn));
+        if (currentPool_ == this) {
+            workers_[currentIndex_]->deque.push(job);
+        } else {
+            std::lock_guard lock(injectMutex_);
+            inject_.push_back(job);
+            injected_.fetch_add(1, std::memory_order_relaxed);
+        }
+        wake();
+    }
+
+    /// Calls fn(i) for every i in [begin, end), splitting the range in halves
+    /// until pieces are at most `grain` long. Blocks until all calls are done;
+    /// a calling worker keeps executing jobs meanwhile.
+    template<typename F>
+    void parallel_for(std::size_t begin, std::size_t end, std::size_t grain, F&& fn);
+
+    /// Runs one queued job on the calling thread.
+    /// @return `true` if a job ran; `false` if none could be found.
+    bool runOne() {
+        auto self = currentPool_ == this ? currentIndex_ : workers_.size();
+        auto job = findJob(self);
+        if (not job) {
+            return false;
+        }
+        run(job);
+        return true;
+    }
+
+private:
+    using Job = std::function<void()>;
+
+    struct alignas(64) Worker
+    {
+        ChaseLevDeque<Job*> deque;
+        std::thread thread;
+        /// Exclusive to this worker
+        std::uint64_t rng = 0;
+    };
+
+    /// `self` is a worker index, or workers_.size() for outside threads
+    Job* findJob(std::size_t self) {
+        if (self < workers_.size()) {
+            if (auto job = workers_[self]->deque.pop()) {
+                return *job;
+            }
+        }
+        if (injected_.load(std::memory_order_relaxed) != 0) {
+            std::lock_guard lock(injectMutex_);
+            if (not inject_.empty()) {
+                auto job = inject_.front();
+                inject_.pop_front();
+                injected_.fetch_sub(1, std::memory_order_relaxed);
+                return job;
+            }
+        }
+        auto count = workers_.size();
+        auto start = self < count ? nextVictim(*workers_[self]) : 0;
+        for (std::size_t i = 0; i < count; ++i) {
+            auto victim = (start + i) % count;
+            if (victim == self) {
+                continue;
+            }
+            if (auto job = workers_[victim]->deque.steal()) {
+                return *job;
+            }
+        }
+        return nullptr;
+    }
+
+    static void run(Job* job) {
+        (*job)();
+        delete job;
+    }
+
+    std::size_t nextVictim(Worker& worker) noexcept {
+        // xorshift64
+        worker.rng ^= worker.rng << 13;
+        worker.rng ^= worker.rng >> 7;
+        worker.rng ^= worker.rng << 17;
+        return worker.rng % workers_.size();
+    }
+
+    void workerLoop(std::size_t index) {
+        currentPool_ = this;
+        currentIndex_ = index;
+        while (not stop_.load(std::memory_order_relaxed)) {
+            if (runOne()) {
+                continue;
+            }
+            bool found = false;
+            for (int spin = 0; spin < 64 and not found; ++spin) {
+                std::this_thread::yield();
+                found = runOne();
+            }
+            if (found) {
+                continue;
+            }
+            auto epoch = epoch_.load(std::memory_order_acquire);
+            sleepers_.fetch_add(1, std::memory_order_relaxed);
+            // Pairs with the fence in wake(): either the submitter sees us
+            // asleep or the retry below sees its job.
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (not runOne() and not stop_.load(std::memory_order_relaxed)) {
+                epoch_.wait(epoch, std::memory_order_acquire);
+            }
+            sleepers_.fetch_sub(1, std::memory_order_relaxed);
+        }
+        currentPool_ = nullptr;
+    }
+
+    /// Pays for a notify only when a worker is asleep
+    void wake() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleepers_.load(std::memory_order_relaxed) != 0) {
+            epoch_.fetch_add(1, std::memory_order_release);
+            epoch_.notify_all();
+        }
+    }
+
+private:
+    std::vector<std::unique_ptr<Worker>> workers_;
+
+    /// Jobs from threads outside the pool
+    std::mutex injectMutex_;
+    std::deque<Job*> inject_;
+    /// Lets workers skip the mutex while inject_ is empty
+    std::atomic<std::size_t> injected_{0};
+
+    std::atomic<bool> stop_{false};
+
+    /// Bumped to wake sleeping workers; the futex word
+    alignas(64) std::atomic<std::uint32_t> epoch_{0};
+    std::atomic<std::uint32_t> sleepers_{0};
+
+    inline static thread_local WorkStealingPool* currentPool_ = nullptr;
+    inline static thread_local std::size_t currentIndex_ = 0;
+};
+
+
+/// Fork/join scope: run() forks a job onto the pool and wait() joins all of
+/// them. The waiting thread executes queued jobs instead of blocking, so
+/// groups nest freely inside jobs.
+class TaskGroup
+{
+public:
+    explicit TaskGroup(WorkStealingPool& pool)
+        : pool_{pool}
+    {}
+
+    TaskGroup(TaskGroup const&) = delete;
+    TaskGroup& operator=(TaskGroup const&) = delete;
+
+    ~TaskGroup() { wait(); }
+
+    /// Fork `fn` onto the pool
+    template<typename F>
+    void run(F&& fn) {
+        pending_.fetch_add(1, std::memory_order_relaxed);
+        pool_.submit([this, fn = std::forward<F>(fn)]() mutable {
+            fn();
+            pending_.fetch_sub(1, std::memory_order_release);
+        });
+    }
+
+    /// Run queued jobs until every job forked through this group has finished
+    void wait() {
+        while (pending_.load(std::memory_order_acquire) != 0) {
+            if (not pool_.runOne()) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+private:
+    WorkStealingPool& pool_;
+    std::atomic<std::size_t> pending_{0};
+};
+
+
+namespace detail {
+template<typename F>
+void forRange(TaskGroup& group, std::size_t begin, std::size_t end, std::size_t grain, F& fn) {
+    while (end - begin > grain) {
+        auto mid = begin + (end - begin) / 2;
+        group.run([&group, mid, end, grain, &fn] {
+            forRange(group, mid, end, grain, fn);
+        });
+        end = mid;
+    }
+    for (auto i = begin; i < end; ++i) {
+        fn(i);
+    }
+}
+} // namespace detail
+
+template<typename F>
+void WorkStealingPool::parallel_for(std::size_t begin, std::size_t end, std::size_t grain, F&& fn) {
+    if (grain == 0) {
+        grain = 1;
+    }
+    TaskGroup group(*this);
+    detail::forRange(group, begin, end, grain, fn);
+    group.wait();
+}